@@ -0,0 +1,478 @@
+/**
+ * @file arith.c
+ * @brief Implementación de la expansión aritmética $((...)) de DWIMSH
+ *
+ * El compilador es un analizador descendente recursivo con niveles de
+ * precedencia como en C. Genera código postfijo que se evalúa con una
+ * pila de enteros de 64 bits. Los operadores && y || usan saltos para
+ * no evaluar el lado derecho cuando no hace falta.
+ */
+
+#include "arith.h"
+#include "vars.h"
+
+/**
+ * @brief Códigos de operación de las expresiones aritméticas
+ */
+enum {
+    A_CONST, A_LOAD, A_STORE,
+    A_NEG, A_NOT, A_BNOT, A_BOOL,
+    A_ADD, A_SUB, A_MUL, A_DIV, A_MOD, A_SHL, A_SHR,
+    A_LT, A_LE, A_GT, A_GE, A_EQ, A_NE,
+    A_BAND, A_BXOR, A_BOR,
+    A_AND_JUMP, A_OR_JUMP, A_JZ, A_JMP
+};
+
+/**
+ * @brief Operadores binarios por nivel de precedencia (de menor a mayor)
+ */
+static const struct {
+    const char *text;
+    int level;
+    int op;
+} binary_ops[] = {
+    {"||", 1, A_OR_JUMP}, {"&&", 2, A_AND_JUMP},
+    {"|", 3, A_BOR}, {"^", 4, A_BXOR}, {"&", 5, A_BAND},
+    {"==", 6, A_EQ}, {"!=", 6, A_NE},
+    {"<", 7, A_LT}, {"<=", 7, A_LE}, {">", 7, A_GT}, {">=", 7, A_GE},
+    {"<<", 8, A_SHL}, {">>", 8, A_SHR},
+    {"+", 9, A_ADD}, {"-", 9, A_SUB},
+    {"*", 10, A_MUL}, {"/", 10, A_DIV}, {"%", 10, A_MOD},
+    {NULL, 0, 0}
+};
+
+// Nivel de precedencia más alto de los operadores binarios
+#define ARITH_MAX_LEVEL 10
+
+/**
+ * @brief Operadores reconocidos, ordenados para probar primero los más largos
+ */
+static const char *arith_tokens[] = {
+    "<<=", ">>=", "||", "&&", "==", "!=", "<=", ">=", "<<", ">>",
+    "+=", "-=", "*=", "/=", "%=", "&=", "^=", "|=",
+    "+", "-", "*", "/", "%", "<", ">", "&", "^", "|", "!", "~",
+    "?", ":", "(", ")", "=", NULL
+};
+
+/**
+ * @brief Estado del compilador de expresiones
+ */
+typedef struct {
+    const char *p;
+    const char *end;
+    ArithExpr *expr;
+    int cap;
+    int error;
+} ArithParser;
+
+/**
+ * @brief Salta los espacios en blanco
+ * @param ap Estado del compilador
+ */
+static void arith_skip(ArithParser *ap) {
+    while (ap->p < ap->end && isspace((unsigned char)*ap->p))
+        ap->p++;
+}
+
+/**
+ * @brief Obtiene el operador en la posición actual sin consumirlo
+ * @param ap Estado del compilador
+ * @return Operador encontrado o NULL si no hay ninguno
+ */
+static const char *arith_peek(ArithParser *ap) {
+    arith_skip(ap);
+    for (int i = 0; arith_tokens[i] != NULL; i++) {
+        size_t len = strlen(arith_tokens[i]);
+        if ((size_t)(ap->end - ap->p) >= len && strncmp(ap->p, arith_tokens[i], len) == 0)
+            return arith_tokens[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief Consume el operador indicado si está en la posición actual
+ * @param ap Estado del compilador
+ * @param op Operador esperado
+ * @return 1 si se consumió, 0 si no
+ */
+static int arith_accept(ArithParser *ap, const char *op) {
+    const char *found = arith_peek(ap);
+    if (found == NULL || strcmp(found, op) != 0)
+        return 0;
+    ap->p += strlen(op);
+    return 1;
+}
+
+/**
+ * @brief Reporta un error de sintaxis (solo el primero)
+ * @param ap Estado del compilador
+ */
+static void arith_syntax_error(ArithParser *ap) {
+    if (ap->error)
+        return;
+    ap->error = 1;
+    arith_skip(ap);
+    fprintf(stderr, "dwimsh: error de sintaxis en la expresión aritmética (el error está en \"%.*s\")\n",
+            (int)(ap->end - ap->p), ap->p);
+}
+
+/**
+ * @brief Añade una instrucción a la expresión
+ * @param ap Estado del compilador
+ * @param op Código de operación
+ * @param value Constante o destino de salto
+ * @return Índice de la instrucción añadida
+ */
+static int arith_emit(ArithParser *ap, int op, long long value) {
+    ArithExpr *expr = ap->expr;
+    if (expr->ncode == ap->cap) {
+        ap->cap = ap->cap ? ap->cap * 2 : 8;
+        expr->code = realloc(expr->code, ap->cap * sizeof(ArithInstr));
+    }
+    ArithInstr *in = &expr->code[expr->ncode];
+    memset(in, 0, sizeof(*in));
+    in->op = op;
+    in->value = value;
+    if (op == A_CONST || op == A_LOAD)
+        expr->max_stack++;
+    return expr->ncode++;
+}
+
+/**
+ * @brief Añade una instrucción que hace referencia a una variable
+ * @param ap Estado del compilador
+ * @param op A_LOAD o A_STORE
+ * @param name Nombre de la variable
+ * @param len Longitud del nombre
+ */
+static void arith_emit_var(ArithParser *ap, int op, const char *name, size_t len) {
+    int at = arith_emit(ap, op, 0);
+    ArithInstr *in = &ap->expr->code[at];
+    in->name = strndup(name, len);
+    in->len = len;
+    in->hash = hash_bytes(name, len);
+}
+
+/**
+ * @brief Lee un nombre de variable (opcionalmente precedido de $)
+ * @param ap Estado del compilador
+ * @param len Longitud del nombre encontrado
+ * @return Inicio del nombre o NULL si no hay un nombre
+ */
+static const char *arith_name(ArithParser *ap, size_t *len) {
+    arith_skip(ap);
+    const char *p = ap->p;
+    if (p < ap->end && *p == '$')
+        p++;
+    if (p >= ap->end || !(isalpha((unsigned char)*p) || *p == '_'))
+        return NULL;
+    const char *start = p;
+    while (p < ap->end && (isalnum((unsigned char)*p) || *p == '_'))
+        p++;
+    *len = p - start;
+    ap->p = p;
+    return start;
+}
+
+static void arith_assign(ArithParser *ap);
+
+/**
+ * @brief Compila un operando con operadores unarios
+ * @param ap Estado del compilador
+ */
+static void arith_unary(ArithParser *ap) {
+    if (ap->error)
+        return;
+
+    if (arith_accept(ap, "-")) {
+        arith_unary(ap);
+        arith_emit(ap, A_NEG, 0);
+        return;
+    }
+    if (arith_accept(ap, "+")) {
+        arith_unary(ap);
+        return;
+    }
+    if (arith_accept(ap, "!")) {
+        arith_unary(ap);
+        arith_emit(ap, A_NOT, 0);
+        return;
+    }
+    if (arith_accept(ap, "~")) {
+        arith_unary(ap);
+        arith_emit(ap, A_BNOT, 0);
+        return;
+    }
+    if (arith_accept(ap, "(")) {
+        arith_assign(ap);
+        if (!arith_accept(ap, ")"))
+            arith_syntax_error(ap);
+        return;
+    }
+
+    arith_skip(ap);
+    if (ap->p < ap->end && isdigit((unsigned char)*ap->p)) {
+        char *end;
+        long long value = strtoll(ap->p, &end, 0);
+        if (end < ap->end && (isalnum((unsigned char)*end) || *end == '_')) {
+            arith_syntax_error(ap);
+            return;
+        }
+        ap->p = end;
+        arith_emit(ap, A_CONST, value);
+        return;
+    }
+
+    size_t len;
+    const char *name = arith_name(ap, &len);
+    if (name == NULL) {
+        arith_syntax_error(ap);
+        return;
+    }
+    arith_emit_var(ap, A_LOAD, name, len);
+}
+
+/**
+ * @brief Compila operadores binarios a partir de un nivel de precedencia
+ * @param ap Estado del compilador
+ * @param level Nivel de precedencia mínimo
+ */
+static void arith_binary(ArithParser *ap, int level) {
+    if (level > ARITH_MAX_LEVEL) {
+        arith_unary(ap);
+        return;
+    }
+
+    arith_binary(ap, level + 1);
+
+    while (!ap->error) {
+        const char *found = arith_peek(ap);
+        int op = -1;
+        for (int i = 0; found != NULL && binary_ops[i].text != NULL; i++) {
+            if (binary_ops[i].level == level && strcmp(binary_ops[i].text, found) == 0)
+                op = binary_ops[i].op;
+        }
+        if (op < 0)
+            return;
+        ap->p += strlen(found);
+
+        if (op == A_AND_JUMP || op == A_OR_JUMP) {
+            int jump = arith_emit(ap, op, 0);
+            arith_binary(ap, level + 1);
+            arith_emit(ap, A_BOOL, 0);
+            ap->expr->code[jump].value = ap->expr->ncode;
+        } else {
+            arith_binary(ap, level + 1);
+            arith_emit(ap, op, 0);
+        }
+    }
+}
+
+/**
+ * @brief Compila una expresión condicional (cond ? a : b)
+ * @param ap Estado del compilador
+ */
+static void arith_ternary(ArithParser *ap) {
+    arith_binary(ap, 1);
+    if (ap->error || !arith_accept(ap, "?"))
+        return;
+
+    int jz = arith_emit(ap, A_JZ, 0);
+    arith_assign(ap);
+    if (!arith_accept(ap, ":")) {
+        arith_syntax_error(ap);
+        return;
+    }
+    int jmp = arith_emit(ap, A_JMP, 0);
+    ap->expr->code[jz].value = ap->expr->ncode;
+    arith_assign(ap);
+    ap->expr->code[jmp].value = ap->expr->ncode;
+}
+
+/**
+ * @brief Compila una asignación (=, +=, -=, ...) o una expresión condicional
+ * @param ap Estado del compilador
+ */
+static void arith_assign(ArithParser *ap) {
+    static const struct {
+        const char *text;
+        int op;
+    } assign_ops[] = {
+        {"=", -1}, {"+=", A_ADD}, {"-=", A_SUB}, {"*=", A_MUL}, {"/=", A_DIV},
+        {"%=", A_MOD}, {"<<=", A_SHL}, {">>=", A_SHR}, {"&=", A_BAND},
+        {"^=", A_BXOR}, {"|=", A_BOR}, {NULL, 0}
+    };
+
+    if (ap->error)
+        return;
+
+    // Mirar si la expresión empieza con NOMBRE seguido de un operador de asignación
+    const char *saved = ap->p;
+    size_t len;
+    const char *name = arith_name(ap, &len);
+    if (name != NULL) {
+        const char *found = arith_peek(ap);
+        for (int i = 0; found != NULL && assign_ops[i].text != NULL; i++) {
+            if (strcmp(found, assign_ops[i].text) != 0)
+                continue;
+            ap->p += strlen(found);
+            if (assign_ops[i].op >= 0)
+                arith_emit_var(ap, A_LOAD, name, len);
+            arith_assign(ap);
+            if (assign_ops[i].op >= 0)
+                arith_emit(ap, assign_ops[i].op, 0);
+            arith_emit_var(ap, A_STORE, name, len);
+            return;
+        }
+    }
+
+    ap->p = saved;
+    arith_ternary(ap);
+}
+
+/**
+ * @brief Libera una expresión aritmética compilada
+ * @param expr Expresión a liberar
+ */
+void arith_free(ArithExpr *expr) {
+    if (expr == NULL)
+        return;
+    for (int i = 0; i < expr->ncode; i++)
+        free(expr->code[i].name);
+    free(expr->code);
+    free(expr);
+}
+
+/**
+ * @brief Compila una expresión aritmética
+ * @param text Texto de la expresión
+ * @param len Longitud del texto
+ * @return Expresión compilada o NULL si hay un error de sintaxis
+ *
+ * Una expresión vacía vale 0, como en bash.
+ */
+ArithExpr *arith_compile(const char *text, size_t len) {
+    ArithParser ap = {text, text + len, calloc(1, sizeof(ArithExpr)), 0, 0};
+
+    arith_skip(&ap);
+    if (ap.p == ap.end) {
+        arith_emit(&ap, A_CONST, 0);
+    } else {
+        arith_assign(&ap);
+        arith_skip(&ap);
+        if (ap.p != ap.end)
+            arith_syntax_error(&ap);
+    }
+
+    if (ap.error) {
+        arith_free(ap.expr);
+        return NULL;
+    }
+    ap.expr->max_stack++;
+    return ap.expr;
+}
+
+/**
+ * @brief Obtiene el valor numérico de una variable
+ * @param in Instrucción A_LOAD con el nombre de la variable
+ * @return Valor de la variable (0 si no existe o no es numérica)
+ */
+static long long arith_load(const ArithInstr *in) {
+    const char *value = var_get_n(in->name, in->len, in->hash);
+    if (value == NULL)
+        return 0;
+    char *end;
+    long long number = strtoll(value, &end, 0);
+    return end == value ? 0 : number;
+}
+
+/**
+ * @brief Evalúa una expresión aritmética compilada
+ * @param expr Expresión a evaluar
+ * @param error Se pone a 1 si ocurre un error (por ejemplo, división por cero)
+ * @return Resultado de la expresión
+ */
+long long arith_eval(const ArithExpr *expr, int *error) {
+    long long local[32];
+    long long *stack = expr->max_stack <= 32 ? local : malloc(expr->max_stack * sizeof(long long));
+    int sp = 0;
+    char number[32];
+
+    *error = 0;
+
+    for (int pc = 0; pc < expr->ncode && !*error; pc++) {
+        const ArithInstr *in = &expr->code[pc];
+        long long a, b;
+
+        switch (in->op) {
+            case A_CONST: stack[sp++] = in->value; continue;
+            case A_LOAD: stack[sp++] = arith_load(in); continue;
+            case A_STORE:
+                snprintf(number, sizeof(number), "%lld", stack[sp - 1]);
+                var_set(in->name, number, -1);
+                continue;
+            case A_NEG: stack[sp - 1] = -(unsigned long long)stack[sp - 1]; continue;
+            case A_NOT: stack[sp - 1] = !stack[sp - 1]; continue;
+            case A_BNOT: stack[sp - 1] = ~stack[sp - 1]; continue;
+            case A_BOOL: stack[sp - 1] = stack[sp - 1] != 0; continue;
+            case A_AND_JUMP:
+                if (stack[sp - 1] == 0)
+                    pc = in->value - 1;
+                else
+                    sp--;
+                continue;
+            case A_OR_JUMP:
+                if (stack[sp - 1] != 0) {
+                    stack[sp - 1] = 1;
+                    pc = in->value - 1;
+                } else {
+                    sp--;
+                }
+                continue;
+            case A_JZ:
+                if (stack[--sp] == 0)
+                    pc = in->value - 1;
+                continue;
+            case A_JMP:
+                pc = in->value - 1;
+                continue;
+        }
+
+        b = stack[--sp];
+        a = stack[sp - 1];
+        switch (in->op) {
+            case A_ADD: a = (unsigned long long)a + b; break;
+            case A_SUB: a = (unsigned long long)a - b; break;
+            case A_MUL: a = (unsigned long long)a * b; break;
+            case A_DIV:
+            case A_MOD:
+                if (b == 0) {
+                    fprintf(stderr, "dwimsh: división por 0\n");
+                    *error = 1;
+                    a = 0;
+                } else if (b == -1) {
+                    a = in->op == A_DIV ? (long long)(-(unsigned long long)a) : 0;
+                } else {
+                    a = in->op == A_DIV ? a / b : a % b;
+                }
+                break;
+            case A_SHL: a = (long long)((unsigned long long)a << (b & 63)); break;
+            case A_SHR: a >>= (b & 63); break;
+            case A_LT: a = a < b; break;
+            case A_LE: a = a <= b; break;
+            case A_GT: a = a > b; break;
+            case A_GE: a = a >= b; break;
+            case A_EQ: a = a == b; break;
+            case A_NE: a = a != b; break;
+            case A_BAND: a &= b; break;
+            case A_BXOR: a ^= b; break;
+            case A_BOR: a |= b; break;
+        }
+        stack[sp - 1] = a;
+    }
+
+    long long result = sp > 0 ? stack[sp - 1] : 0;
+    if (stack != local)
+        free(stack);
+    return result;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file arith.h
+ * @brief Definición de la expansión aritmética $((...)) de DWIMSH
+ *
+ * Las expresiones aritméticas se compilan una sola vez a una secuencia
+ * de instrucciones de pila, de modo que evaluarlas en un bucle no
+ * requiere volver a analizar el texto.
+ */
+
+#ifndef ARITH_H
+#define ARITH_H
+
+#include "shell.h"
+
+/**
+ * @brief Instrucción de una expresión aritmética compilada
+ */
+typedef struct {
+    /** Código de operación (ver arith.c) */
+    int op;
+    /** Constante o destino de salto, según la operación */
+    long long value;
+    /** Nombre de la variable (solo carga y asignación) */
+    char *name;
+    /** Longitud del nombre */
+    size_t len;
+    /** Hash del nombre calculado con hash_bytes */
+    unsigned int hash;
+} ArithInstr;
+
+/**
+ * @brief Expresión aritmética compilada
+ */
+typedef struct {
+    /** Instrucciones en notación postfija */
+    ArithInstr *code;
+    /** Número de instrucciones */
+    int ncode;
+    /** Profundidad máxima de la pila de evaluación */
+    int max_stack;
+} ArithExpr;
+
+/**
+ * @brief Compila una expresión aritmética
+ * @param text Texto de la expresión
+ * @param len Longitud del texto
+ * @return Expresión compilada o NULL si hay un error de sintaxis
+ */
+ArithExpr *arith_compile(const char *text, size_t len);
+
+/**
+ * @brief Evalúa una expresión aritmética compilada
+ * @param expr Expresión a evaluar
+ * @param error Se pone a 1 si ocurre un error (por ejemplo, división por cero)
+ * @return Resultado de la expresión
+ */
+long long arith_eval(const ArithExpr *expr, int *error);
+
+/**
+ * @brief Libera una expresión aritmética compilada
+ * @param expr Expresión a liberar
+ */
+void arith_free(ArithExpr *expr);
+
+#endif // ARITH_H
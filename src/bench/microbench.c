@@ -0,0 +1,353 @@
+/**
+ * @file microbench.c
+ * @brief Microbenchmarks del sistema de sugerencias y de la búsqueda de comandos
+ *
+ * Mide levenshtein, is_anagram, suggest_command, command_exists y
+ * bin_commands (load_commands) sobre corpus sintéticos de nombres de
+ * comandos de 1k a 200k entradas. Los nombres se generan con una semilla
+ * fija, así que dos ejecuciones usan exactamente los mismos datos.
+ *
+ * Cada medida se repite BENCH_REPEATS veces y se emite una línea JSON con
+ * la mediana y el mínimo en nanosegundos por operación.
+ *
+ * Uso: microbench [tamaño...]   (por defecto 1000 10000 50000 200000)
+ */
+
+#include "../shell.h"
+#include "../suggestions.h"
+
+// Repeticiones de cada medida (se informa la mediana y el mínimo)
+#define BENCH_REPEATS 5
+
+// Consultas distintas que se comparan contra todo el corpus
+#define BENCH_QUERIES 16
+
+// Tamaños de corpus por defecto
+static const int default_sizes[] = {1000, 10000, 50000, 200000};
+
+/**
+ * @brief Generador pseudoaleatorio xorshift64 (reproducible en cualquier máquina)
+ * @param state Estado del generador
+ * @return Siguiente número pseudoaleatorio
+ */
+static uint64_t xorshift(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+/**
+ * @brief Genera un corpus de nombres de comandos sintéticos
+ * @param n Número de nombres
+ * @return Arreglo de n nombres únicos reservados con malloc
+ *
+ * Los nombres tienen entre 2 y 14 letras (como los de /usr/bin) y un
+ * sufijo numérico cuando hace falta para que no se repitan.
+ */
+static char **make_corpus(int n) {
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    char **names = malloc(n * sizeof(char *));
+    char name[32];
+
+    for (int i = 0; i < n; i++) {
+        int len = 2 + (int)(xorshift(&state) % 13);
+        for (int j = 0; j < len; j++)
+            name[j] = "abcdefghijklmnopqrstuvwxyz-"[xorshift(&state) % (j == 0 ? 26 : 27)];
+        name[len] = '\0';
+        if (i >= 676)
+            snprintf(name + len, sizeof(name) - len, "%d", i);
+        names[i] = strdup(name);
+    }
+    return names;
+}
+
+/**
+ * @brief Libera un corpus
+ * @param names Nombres
+ * @param n Número de nombres
+ */
+static void free_corpus(char **names, int n) {
+    for (int i = 0; i < n; i++)
+        free(names[i]);
+    free(names);
+}
+
+/**
+ * @brief Tiempo monotónico actual en nanosegundos
+ * @return Nanosegundos
+ */
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief Compara dos double para qsort
+ */
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief Emite el resultado de una medida como una línea JSON
+ * @param name Nombre del benchmark
+ * @param corpus Tamaño del corpus
+ * @param ops Operaciones por repetición
+ * @param samples Nanosegundos de cada repetición
+ */
+static void report(const char *name, int corpus, long ops, double *samples) {
+    qsort(samples, BENCH_REPEATS, sizeof(double), compare_double);
+    printf("{\"benchmark\": \"%s\", \"corpus\": %d, \"ops\": %ld, "
+           "\"ns_per_op_median\": %.1f, \"ns_per_op_min\": %.1f}\n",
+           name, corpus, ops, samples[BENCH_REPEATS / 2] / ops, samples[0] / ops);
+    fflush(stdout);
+}
+
+// Evita que el compilador descarte los resultados
+static volatile long sink;
+
+// /dev/null, donde se descarta lo que escribe suggest_command
+static int null_fd = -1;
+
+/**
+ * @brief Mide levenshtein contra todo el corpus
+ * @param names Corpus
+ * @param n Tamaño del corpus
+ * @param queries Consultas
+ */
+static void bench_levenshtein(char **names, int n, char **queries) {
+    double samples[BENCH_REPEATS];
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        double start = now_ns();
+        long total = 0;
+        for (int q = 0; q < BENCH_QUERIES; q++) {
+            for (int i = 0; i < n; i++)
+                total += levenshtein(queries[q], names[i]);
+        }
+        sink = total;
+        samples[r] = now_ns() - start;
+    }
+    report("levenshtein", n, (long)n * BENCH_QUERIES, samples);
+}
+
+/**
+ * @brief Mide is_anagram contra todo el corpus
+ * @param names Corpus
+ * @param n Tamaño del corpus
+ * @param queries Consultas
+ */
+static void bench_is_anagram(char **names, int n, char **queries) {
+    double samples[BENCH_REPEATS];
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        double start = now_ns();
+        long total = 0;
+        for (int q = 0; q < BENCH_QUERIES; q++) {
+            for (int i = 0; i < n; i++)
+                total += is_anagram(queries[q], names[i]);
+        }
+        sink = total;
+        samples[r] = now_ns() - start;
+    }
+    report("is_anagram", n, (long)n * BENCH_QUERIES, samples);
+}
+
+/**
+ * @brief Mide suggest_command con el corpus como lista de comandos
+ * @param names Corpus
+ * @param n Tamaño del corpus
+ * @param queries Consultas
+ *
+ * La pregunta "¿Quieres decir...?" va a /dev/null y se responde con fin
+ * de archivo, así que se mide solo la búsqueda de sugerencias.
+ */
+static void bench_suggest_command(char **names, int n, char **queries) {
+    double samples[BENCH_REPEATS];
+    char **saved_commands = commands;
+    int saved_count = command_count;
+
+    fflush(stdout);
+    int out_fd = dup(STDOUT_FILENO);
+    dup2(null_fd, STDOUT_FILENO);
+    commands = names;
+    command_count = n;
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        double start = now_ns();
+        for (int q = 0; q < BENCH_QUERIES; q++) {
+            char *args[] = {queries[q], NULL};
+            suggest_command(queries[q], args);
+        }
+        samples[r] = now_ns() - start;
+    }
+    commands = saved_commands;
+    command_count = saved_count;
+    fflush(stdout);
+    dup2(out_fd, STDOUT_FILENO);
+    close(out_fd);
+    report("suggest_command", n, BENCH_QUERIES, samples);
+}
+
+/**
+ * @brief Crea un directorio con un ejecutable vacío por cada nombre del corpus
+ * @param names Corpus
+ * @param n Tamaño del corpus
+ * @param dir Búfer donde se guarda la ruta del directorio
+ * @param size Tamaño del búfer
+ * @return 0 si se creó, -1 si hubo un error
+ */
+static int make_bin_dir(char **names, int n, char *dir, size_t size) {
+    const char *tmp = getenv("TMPDIR");
+    snprintf(dir, size, "%s/dwimsh-bench-XXXXXX", tmp && *tmp ? tmp : "/tmp");
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        return -1;
+    }
+
+    char path[1024];
+    for (int i = 0; i < n; i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0755);
+        if (fd < 0) {
+            perror(path);
+            return -1;
+        }
+        close(fd);
+    }
+    return 0;
+}
+
+/**
+ * @brief Borra el directorio creado por make_bin_dir
+ * @param names Corpus
+ * @param n Tamaño del corpus
+ * @param dir Ruta del directorio
+ */
+static void remove_bin_dir(char **names, int n, const char *dir) {
+    char path[1024];
+    for (int i = 0; i < n; i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+        unlink(path);
+    }
+    rmdir(dir);
+}
+
+/**
+ * @brief Libera la lista global de comandos
+ */
+static void free_commands(void) {
+    for (int i = 0; i < command_count; i++)
+        free(commands[i]);
+    free(commands);
+    commands = NULL;
+    command_count = 0;
+}
+
+/**
+ * @brief Mide load_commands (lo que hace bin_commands) sobre un directorio del corpus
+ * @param n Tamaño del corpus
+ * @param dir Directorio con los ejecutables
+ */
+static void bench_bin_commands(int n, const char *dir) {
+    double samples[BENCH_REPEATS];
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        double start = now_ns();
+        load_commands(dir);
+        samples[r] = now_ns() - start;
+        free_commands();
+    }
+    report("bin_commands", n, 1, samples);
+}
+
+/**
+ * @brief Mide command_exists con el directorio del corpus al final del PATH
+ * @param names Corpus
+ * @param n Tamaño del corpus
+ * @param dir Directorio con los ejecutables
+ *
+ * La mitad de las búsquedas son de comandos que existen y la otra mitad
+ * de comandos inexistentes (el caso de un error de escritura).
+ */
+static void bench_command_exists(char **names, int n, const char *dir) {
+    double samples[BENCH_REPEATS];
+    char *saved_path = getenv("PATH") ? strdup(getenv("PATH")) : NULL;
+    char path[4096];
+    int lookups = 2000;
+
+    snprintf(path, sizeof(path), "/usr/local/bin:/usr/bin:/bin:%s", dir);
+    setenv("PATH", path, 1);
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        double start = now_ns();
+        long found = 0;
+        for (int i = 0; i < lookups; i++) {
+            if (i % 2 == 0) {
+                found += command_exists(names[(i * 7919) % n]);
+            } else {
+                char missing[64];
+                snprintf(missing, sizeof(missing), "no-such-%d", i);
+                found += command_exists(missing);
+            }
+        }
+        sink = found;
+        samples[r] = now_ns() - start;
+    }
+    if (saved_path != NULL) {
+        setenv("PATH", saved_path, 1);
+        free(saved_path);
+    }
+    report("command_exists", n, lookups, samples);
+}
+
+/**
+ * @brief Punto de entrada de los microbenchmarks
+ * @param argc Número de argumentos
+ * @param argv Tamaños de corpus opcionales
+ * @return 0 si todo fue bien
+ */
+int main(int argc, char *argv[]) {
+    int nsizes = argc > 1 ? argc - 1 : (int)(sizeof(default_sizes) / sizeof(int));
+
+    // suggest_command pregunta por stdin: la respuesta es siempre fin de archivo
+    null_fd = open("/dev/null", O_RDWR);
+    dup2(null_fd, STDIN_FILENO);
+
+    for (int s = 0; s < nsizes; s++) {
+        int n = argc > 1 ? atoi(argv[s + 1]) : default_sizes[s];
+        if (n <= 0)
+            continue;
+        char **names = make_corpus(n);
+
+        // Consultas: errores de escritura típicos de nombres del corpus
+        char *queries[BENCH_QUERIES];
+        for (int q = 0; q < BENCH_QUERIES; q++) {
+            char *query = strdup(names[(q * 104729) % n]);
+            size_t len = strlen(query);
+            if (len > 2) {
+                char c = query[0];
+                query[0] = query[1];
+                query[1] = c;
+            }
+            queries[q] = query;
+        }
+
+        fprintf(stderr, "microbench: corpus de %d nombres\n", n);
+        bench_levenshtein(names, n, queries);
+        bench_is_anagram(names, n, queries);
+
+        bench_suggest_command(names, n, queries);
+
+        char dir[1024];
+        if (make_bin_dir(names, n, dir, sizeof(dir)) == 0) {
+            bench_bin_commands(n, dir);
+            bench_command_exists(names, n, dir);
+        }
+        remove_bin_dir(names, n, dir);
+
+        for (int q = 0; q < BENCH_QUERIES; q++)
+            free(queries[q]);
+        free_corpus(names, n);
+    }
+    return 0;
+}
@@ -0,0 +1,208 @@
+/**
+ * @file server_bench.c
+ * @brief Peticiones por segundo del modo servidor frente a lanzar una shell nueva
+ *
+ * Ejecuta el mismo comando durante BENCH_SECONDS segundos de cada forma:
+ *   fresh_shell_c            un proceso dwimsh -c nuevo por petición
+ *   fresh_shell_interactive  un proceso dwimsh nuevo por petición, con el
+ *                            comando por stdin (carga comandos y readline)
+ *   thin_client              un proceso dwimsh --client nuevo por petición
+ *   socket_N                 N conexiones persistentes al servidor desde
+ *                            este mismo programa (client_request)
+ *
+ * Emite una línea JSON por forma con las peticiones completadas y las
+ * peticiones por segundo.
+ *
+ * Uso: server_bench [ruta a dwimsh] [comando]
+ */
+
+#include "../shell.h"
+#include "../server.h"
+
+// Duración de cada medida
+#define BENCH_SECONDS 2.0
+
+// Ruta del ejecutable bajo prueba
+static const char *shell_path = "./dwimsh";
+
+// Socket del servidor lanzado por el benchmark
+static char socket_path[108];
+
+/**
+ * @brief Tiempo monotónico actual en segundos
+ * @return Segundos
+ */
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Emite el resultado de una medida como una línea JSON
+ * @param mode Forma de ejecutar el comando
+ * @param requests Peticiones completadas
+ * @param failed Peticiones con estado distinto de 0
+ * @param seconds Duración de la medida
+ */
+static void report(const char *mode, long requests, long failed, double seconds) {
+    printf("{\"benchmark\": \"server_rps\", \"mode\": \"%s\", \"requests\": %ld, \"failed\": %ld, "
+           "\"seconds\": %.3f, \"rps\": %.1f}\n",
+           mode, requests, failed, seconds, requests / seconds);
+    fflush(stdout);
+}
+
+/**
+ * @brief Lanza dwimsh con salida a /dev/null y espera a que termine
+ * @param argv Argumentos
+ * @param input Texto para su entrada estándar (NULL para /dev/null)
+ * @return Estado de salida
+ */
+static int spawn(char *const argv[], const char *input) {
+    int fds[2] = {-1, -1};
+    if (input != NULL && pipe(fds) < 0)
+        return -1;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_RDWR);
+        dup2(input != NULL ? fds[0] : null_fd, STDIN_FILENO);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        if (input != NULL) {
+            close(fds[0]);
+            close(fds[1]);
+        }
+        execv(shell_path, argv);
+        _exit(127);
+    }
+    if (input != NULL) {
+        close(fds[0]);
+        if (write(fds[1], input, strlen(input)) < 0)
+            perror("write");
+        close(fds[1]);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/**
+ * @brief Mide una forma de ejecutar el comando que lanza un proceso por petición
+ * @param mode Nombre de la forma
+ * @param argv Argumentos de dwimsh
+ * @param input Texto para su entrada estándar (NULL para /dev/null)
+ */
+static void bench_spawn(const char *mode, char *const argv[], const char *input) {
+    long requests = 0, failed = 0;
+    double start = now_s(), elapsed;
+    do {
+        if (spawn(argv, input) != 0)
+            failed++;
+        requests++;
+        elapsed = now_s() - start;
+    } while (elapsed < BENCH_SECONDS);
+    report(mode, requests, failed, elapsed);
+}
+
+/**
+ * @brief Mide N conexiones persistentes al servidor, cada una en su proceso
+ * @param connections Número de conexiones simultáneas
+ * @param command Comando a ejecutar
+ */
+static void bench_socket(int connections, const char *command) {
+    int results[2];
+    if (pipe(results) < 0)
+        return;
+
+    pid_t workers[connections];
+    double start = now_s();
+    for (int w = 0; w < connections; w++) {
+        workers[w] = fork();
+        if (workers[w] != 0)
+            continue;
+        int sock = client_connect(socket_path);
+        int null_fd = open("/dev/null", O_RDWR);
+        int fds[3] = {null_fd, null_fd, null_fd};
+        long counts[2] = {0, 0};
+        while (sock >= 0 && now_s() - start < BENCH_SECONDS) {
+            int status;
+            if (client_request(sock, command, "/", NULL, 0, 0, fds, 3, &status, NULL, NULL) < 0)
+                break;
+            if (status != 0)
+                counts[1]++;
+            counts[0]++;
+        }
+        if (write(results[1], counts, sizeof(counts)) < 0)
+            perror("write");
+        _exit(0);
+    }
+    close(results[1]);
+
+    long requests = 0, failed = 0, counts[2];
+    while (read(results[0], counts, sizeof(counts)) == sizeof(counts)) {
+        requests += counts[0];
+        failed += counts[1];
+    }
+    close(results[0]);
+    for (int w = 0; w < connections; w++)
+        waitpid(workers[w], NULL, 0);
+    double elapsed = now_s() - start;
+
+    char mode[32];
+    snprintf(mode, sizeof(mode), "socket_%d", connections);
+    report(mode, requests, failed, elapsed);
+}
+
+/**
+ * @brief Punto de entrada del benchmark
+ * @param argc Número de argumentos
+ * @param argv Ruta de dwimsh y comando opcionales
+ * @return 0 si todo fue bien
+ */
+int main(int argc, char *argv[]) {
+    char *command = "echo hola";
+    if (argc > 1)
+        shell_path = argv[1];
+    if (argc > 2)
+        command = argv[2];
+
+    snprintf(socket_path, sizeof(socket_path), "/tmp/dwimsh-bench-%d.sock", (int)getpid());
+    pid_t server = fork();
+    if (server == 0) {
+        int null_fd = open("/dev/null", O_RDWR);
+        dup2(null_fd, STDERR_FILENO);
+        execl(shell_path, "dwimsh", "--server", socket_path, (char *)NULL);
+        _exit(127);
+    }
+
+    // Esperar a que el servidor acepte conexiones
+    int sock = -1;
+    for (int i = 0; i < 500 && sock < 0; i++) {
+        sock = client_connect(socket_path);
+        if (sock < 0)
+            usleep(10000);
+    }
+    if (sock < 0) {
+        fprintf(stderr, "server_bench: el servidor no arrancó\n");
+        kill(server, SIGTERM);
+        return 1;
+    }
+    close(sock);
+
+    char *fresh_c[] = {"dwimsh", "-c", command, NULL};
+    char *fresh_interactive[] = {"dwimsh", NULL};
+    char *thin_client[] = {"dwimsh", "--client", "-s", socket_path, command, NULL};
+    char input[4096];
+    snprintf(input, sizeof(input), "%s\nexit\n", command);
+
+    bench_spawn("fresh_shell_c", fresh_c, NULL);
+    bench_spawn("fresh_shell_interactive", fresh_interactive, input);
+    bench_spawn("thin_client", thin_client, NULL);
+    bench_socket(1, command);
+    bench_socket(8, command);
+
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+    return 0;
+}
@@ -3,19 +3,39 @@
  * @brief Implementación de los comandos built-in de DWIMSH
  * 
  * Este archivo contiene la implementación de los comandos built-in
- * de la shell, como cd, pwd, echo y exit.
+ * de la shell, como cd, pwd, echo y exit, además de versiones internas
+ * de utilidades de coreutils muy usadas en bucles (true, false, test, [,
+ * printf, basename, dirname y sleep) que evitan el coste de fork+execvp.
  */
 
 #include "builtins.h"
+#include "vars.h"
+#include "jobs.h"
 
 /**
  * @brief Array con los comandos built-in disponibles
  */
 BuiltInCommand builtin_commands[] = {
-    {"cd", cmd_cd},
+    {"cd", cmd_cd, 1},
     {"pwd", cmd_pwd},
     {"echo", cmd_echo},
-    {"exit", cmd_exit}
+    {"exit", cmd_exit, 1},
+    {"true", cmd_true},
+    {":", cmd_true},
+    {"false", cmd_false},
+    {"test", cmd_test},
+    {"[", cmd_test},
+    {"printf", cmd_printf},
+    {"basename", cmd_basename},
+    {"dirname", cmd_dirname},
+    {"sleep", cmd_sleep},
+    {"enable", cmd_enable, 1},
+    {"export", cmd_export, 1},
+    {"unset", cmd_unset, 1},
+    {"jobs", cmd_jobs, 1},
+    {"jobtail", cmd_jobtail, 1},
+    {"jobdump", cmd_jobdump, 1},
+    {"jobstream", cmd_jobstream, 1}
 };
 
 // Número de comandos built-in disponibles
@@ -82,29 +102,1765 @@ void cmd_echo(char **args) {
 
 /**
  * @brief Implementa el comando built-in exit (salir de la shell)
- * @param args Argumentos del comando (no utilizados)
+ * @param args Argumentos del comando (args[1] es el estado de salida opcional)
+ *
+ * Sin argumento sale con el estado del último comando.
  */
 void cmd_exit(char **args) {
-    printf("Saliendo de dwimsh...\n");
-    exit(0);
+    int status = last_command_status;
+
+    if (args[1] != NULL) {
+        char *end;
+        long value = strtol(args[1], &end, 10);
+        if (*args[1] == '\0' || *end != '\0') {
+            fprintf(stderr, "dwimsh: exit: %s: se requiere un argumento numérico\n", args[1]);
+            value = 2;
+        }
+        status = (int)(value & 0xff);
+    }
+    if (interactive && !subshell)
+        printf("Saliendo de dwimsh...\n");
+    exit(status);
+}
+
+/**
+ * @brief Indica si el único argumento de un comando es --help o --version
+ * @param args Argumentos del comando
+ * @return 1 si es así, 0 si no
+ */
+static int is_info_option(char **args) {
+    return args[1] != NULL && args[2] == NULL &&
+           (strcmp(args[1], "--help") == 0 || strcmp(args[1], "--version") == 0);
+}
+
+/**
+ * @brief Ejecuta el binario de coreutils en lugar del built-in
+ * @param args Argumentos del comando
+ *
+ * Se usa para --help y --version: el texto de ayuda y de versión solo
+ * lo tiene el binario.
+ */
+static void run_coreutils(char **args) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        last_command_status = 1;
+        return;
+    }
+    if (pid == 0) {
+        signal(SIGINT, SIG_DFL);
+        execvp(args[0], args);
+        fprintf(stderr, "%s: %s\n", args[0], strerror(errno));
+        _exit(127);
+    }
+
+    int status;
+    current_child_pid = pid;
+    foreground_process_running = 1;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+        ;
+    last_command_status = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+    current_child_pid = 0;
+    foreground_process_running = 0;
+}
+
+/**
+ * @brief Implementa el comando built-in true
+ * @param args Argumentos del comando (ignorados)
+ *
+ * Como en coreutils, "true --help" y "true --version" (solos) muestran
+ * la ayuda o la versión; ":" ignora siempre sus argumentos.
+ */
+void cmd_true(char **args) {
+    if (strcmp(args[0], "true") == 0 && is_info_option(args)) {
+        run_coreutils(args);
+        return;
+    }
+    last_command_status = 0;
+}
+
+/**
+ * @brief Implementa el comando built-in false
+ * @param args Argumentos del comando (ignorados)
+ *
+ * "false --help" y "false --version" (solos) muestran la ayuda o la
+ * versión y terminan con estado 1, como en coreutils.
+ */
+void cmd_false(char **args) {
+    if (is_info_option(args)) {
+        run_coreutils(args);
+        return;
+    }
+    last_command_status = 1;
+}
+
+/**
+ * @brief Obtiene el locale del entorno si su juego de caracteres es UTF-8
+ * @return Locale (se libera con freelocale), o (locale_t)0 si no es UTF-8
+ *
+ * Como setlocale(LC_ALL, "") en coreutils: un locale inválido deja el de C.
+ */
+static locale_t utf8_locale(void) {
+    locale_t loc = newlocale(LC_ALL_MASK, "", (locale_t)0);
+    if (loc != (locale_t)0 && strcasecmp(nl_langinfo_l(CODESET, loc), "UTF-8") != 0) {
+        freelocale(loc);
+        loc = (locale_t)0;
+    }
+    return loc;
+}
+
+/**
+ * @brief Cita un argumento para un mensaje de error igual que quote() de coreutils
+ * @param arg Argumento a citar
+ * @return Cadena citada (se conservan las cuatro últimas)
+ *
+ * Con un locale UTF-8 usa las comillas tipográficas ‘ y ’, y en otro caso
+ * comillas simples ASCII; la comilla de cierre, la barra invertida y los
+ * caracteres no imprimibles se escapan. Los mensajes coinciden con los de
+ * coreutils sin traducir (locales C, POSIX o C.UTF-8); con un catálogo de
+ * traducciones instalado los binarios escriben otro texto.
+ */
+static const char *quote(const char *arg) {
+    static char *buffers[4];
+    static int next;
+
+    size_t len = strlen(arg);
+    char *buf = realloc(buffers[next], len * 4 + 7);
+    if (buf == NULL)
+        return arg;
+    buffers[next] = buf;
+    next = (next + 1) % 4;
+
+    locale_t loc = utf8_locale();
+    int utf8 = loc != (locale_t)0;
+    locale_t old = utf8 ? uselocale(loc) : (locale_t)0;
+    const char *right = utf8 ? "\xe2\x80\x99" : "'";
+    size_t right_len = strlen(right);
+    mbstate_t state;
+    memset(&state, 0, sizeof(state));
+
+    char *out = stpcpy(buf, utf8 ? "\xe2\x80\x98" : "'");
+    for (size_t i = 0; i < len;) {
+        unsigned char c = arg[i];
+        const char *esc = c < 32 ? strchr("\aa\bb\ff\nn\rr\tt\vv", c) : NULL;
+        wchar_t wc;
+        size_t n = 1;
+
+        if (strncmp(arg + i, right, right_len) == 0 || c == '\\') {
+            *out++ = '\\';
+            n = c == '\\' ? 1 : right_len;
+            memcpy(out, arg + i, n);
+            out += n;
+        } else if (esc != NULL) {
+            *out++ = '\\';
+            *out++ = esc[1];
+        } else if (c < 128 ? isprint(c) :
+                   utf8 && (n = mbrtowc(&wc, arg + i, len - i, &state)) < (size_t)-2 && iswprint(wc)) {
+            memcpy(out, arg + i, n);
+            out += n;
+        } else {
+            out += sprintf(out, "\\%03o", c);
+            n = 1;
+            memset(&state, 0, sizeof(state));
+        }
+        i += n;
+    }
+    strcpy(out, right);
+
+    if (utf8) {
+        uselocale(old);
+        freelocale(loc);
+    }
+    return buf;
+}
+
+// Estado del evaluador de expresiones de test. Como en test.c de coreutils,
+// test_argv[0] es el nombre del comando y la expresión empieza en la posición 1
+static char **test_argv;
+static int test_argc;
+static int test_pos;
+static jmp_buf test_error;
+
+/**
+ * @brief Reporta un error de sintaxis de test y abandona la evaluación
+ * @param fmt Formato del mensaje, seguido de sus argumentos
+ *
+ * Vuelve a cmd_test, que termina con estado 2.
+ */
+static void test_syntax_error(const char *fmt, ...) {
+    va_list ap;
+
+    fprintf(stderr, "%s: ", test_argv[0]);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    longjmp(test_error, 1);
+}
+
+/**
+ * @brief Reporta que a la expresión le falta un argumento al final
+ */
+static void test_beyond(void) {
+    test_syntax_error("missing argument after %s", quote(test_argv[test_argc - 1]));
+}
+
+/**
+ * @brief Avanza al siguiente argumento de la expresión
+ * @param required Si es 1, es un error que no haya más argumentos
+ */
+static void test_advance(int required) {
+    test_pos++;
+    if (required && test_pos >= test_argc)
+        test_beyond();
+}
+
+/**
+ * @brief Valida un operando entero de test
+ * @param s Operando a validar
+ * @return Puntero al signo o primer dígito del número dentro de s
+ *
+ * Se admiten espacios o tabuladores alrededor y un signo; no hay límite
+ * de longitud porque los enteros se comparan como cadenas.
+ */
+static const char *test_find_int(const char *s) {
+    const char *p = s;
+    const char *number;
+
+    while (*p == ' ' || *p == '\t')
+        p++;
+    if (*p == '+') {
+        number = ++p;
+    } else {
+        number = p;
+        p += *p == '-';
+    }
+    if (isdigit((unsigned char)*p++)) {
+        while (isdigit((unsigned char)*p))
+            p++;
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '\0')
+            return number;
+    }
+    test_syntax_error("invalid integer %s", quote(s));
+    return NULL;
+}
+
+/**
+ * @brief Compara dos enteros validados por test_find_int sin convertirlos
+ * @param a Primer entero
+ * @param b Segundo entero
+ * @return Negativo, 0 o positivo si a es menor, igual o mayor que b
+ */
+static int test_intcmp(const char *a, const char *b) {
+    int negative_a = *a == '-';
+    int negative_b = *b == '-';
+
+    a += negative_a;
+    b += negative_b;
+    while (*a == '0')
+        a++;
+    while (*b == '0')
+        b++;
+    size_t len_a = strspn(a, "0123456789");
+    size_t len_b = strspn(b, "0123456789");
+
+    // -0 y 0 son el mismo número
+    negative_a = negative_a && len_a > 0;
+    negative_b = negative_b && len_b > 0;
+    if (negative_a != negative_b)
+        return negative_a ? -1 : 1;
+
+    int cmp = len_a != len_b ? (len_a < len_b ? -1 : 1) : strncmp(a, b, len_a);
+    return negative_a ? -cmp : cmp;
+}
+
+/**
+ * @brief Indica si una cadena es un operador binario de test
+ * @param op Cadena a verificar
+ * @return 1 si es operador binario, 0 si no
+ */
+static int test_is_binary_op(const char *op) {
+    static const char *ops[] = {
+        "=", "==", "!=", "-eq", "-ne", "-lt", "-le", "-gt", "-ge", "-nt", "-ot", "-ef", NULL
+    };
+    for (int i = 0; ops[i] != NULL; i++) {
+        if (strcmp(op, ops[i]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Indica si una cadena es un operador unario de test
+ * @param op Cadena a verificar
+ * @return 1 si es operador unario, 0 si no
+ */
+static int test_is_unary_op(const char *op) {
+    return op[0] == '-' && op[1] != '\0' && op[2] == '\0' &&
+           strchr("bcdefgGhkLnNOprsStuwxz", op[1]) != NULL;
+}
+
+/**
+ * @brief Evalúa el operador unario de la posición actual y su operando
+ * @return 1 si la expresión es verdadera, 0 si no
+ */
+static int test_unary(void) {
+    char op = test_argv[test_pos][1];
+    struct stat st;
+
+    test_advance(1);
+    const char *arg = test_argv[test_pos++];
+
+    switch (op) {
+        case 'n': return arg[0] != '\0';
+        case 'z': return arg[0] == '\0';
+        case 'r': return access(arg, R_OK) == 0;
+        case 'w': return access(arg, W_OK) == 0;
+        case 'x': return access(arg, X_OK) == 0;
+        case 'h':
+        case 'L': return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+        case 't': {
+            const char *number = test_find_int(arg);
+            errno = 0;
+            long fd = strtol(number, NULL, 10);
+            return errno != ERANGE && fd >= 0 && fd <= INT_MAX && isatty((int)fd);
+        }
+    }
+
+    if (stat(arg, &st) != 0)
+        return 0;
+
+    switch (op) {
+        case 'e': return 1;
+        case 'f': return S_ISREG(st.st_mode);
+        case 'd': return S_ISDIR(st.st_mode);
+        case 'b': return S_ISBLK(st.st_mode);
+        case 'c': return S_ISCHR(st.st_mode);
+        case 'p': return S_ISFIFO(st.st_mode);
+        case 'S': return S_ISSOCK(st.st_mode);
+        case 's': return st.st_size > 0;
+        case 'u': return (st.st_mode & S_ISUID) != 0;
+        case 'g': return (st.st_mode & S_ISGID) != 0;
+        case 'k': return (st.st_mode & S_ISVTX) != 0;
+        case 'O': return st.st_uid == geteuid();
+        case 'G': return st.st_gid == getegid();
+        case 'N':
+            return st.st_mtim.tv_sec > st.st_atim.tv_sec ||
+                   (st.st_mtim.tv_sec == st.st_atim.tv_sec && st.st_mtim.tv_nsec > st.st_atim.tv_nsec);
+    }
+    return 0;
+}
+
+/**
+ * @brief Compara las fechas de modificación de dos archivos (-nt y -ot)
+ * @param a Primer archivo
+ * @param b Segundo archivo
+ * @return 1 si a es más reciente que b o solo existe a, 0 si no
+ */
+static int test_newer(const char *a, const char *b) {
+    struct stat sa, sb;
+
+    if (stat(a, &sa) != 0)
+        return 0;
+    if (stat(b, &sb) != 0)
+        return 1;
+    return sa.st_mtim.tv_sec > sb.st_mtim.tv_sec ||
+           (sa.st_mtim.tv_sec == sb.st_mtim.tv_sec && sa.st_mtim.tv_nsec > sb.st_mtim.tv_nsec);
+}
+
+/**
+ * @brief Evalúa el operador binario que sigue a la posición actual
+ * @param l_is_l 1 si el operando izquierdo es de la forma "-l cadena"
+ * @return 1 si la expresión es verdadera, 0 si no
+ *
+ * Los operadores enteros aceptan "-l cadena" a cada lado, que vale la
+ * longitud de la cadena. Los índices de los operandos siguen a
+ * coreutils al pie de la letra, también en los casos raros en los que
+ * "-l" acompaña a un operador de cadenas.
+ */
+static int test_binary(int l_is_l) {
+    if (l_is_l)
+        test_advance(0);
+    int op_pos = test_pos + 1;
+    const char *op = test_argv[op_pos];
+    int r_is_l = op_pos < test_argc - 2 && strcmp(test_argv[op_pos + 1], "-l") == 0;
+    if (r_is_l)
+        test_advance(0);
+
+    int file_op = strcmp(op, "-nt") == 0 || strcmp(op, "-ot") == 0 || strcmp(op, "-ef") == 0;
+
+    if (op[0] == '-' && !file_op) {
+        char lbuf[24], rbuf[24];
+        const char *l = test_argv[op_pos - 1];
+        const char *r = test_argv[op_pos + 1 + r_is_l];
+
+        if (l_is_l) {
+            snprintf(lbuf, sizeof(lbuf), "%zu", strlen(l));
+            l = lbuf;
+        } else {
+            l = test_find_int(l);
+        }
+        if (r_is_l) {
+            snprintf(rbuf, sizeof(rbuf), "%zu", strlen(r));
+            r = rbuf;
+        } else {
+            r = test_find_int(r);
+        }
+        int cmp = test_intcmp(l, r);
+        test_pos += 3;
+
+        if (strcmp(op, "-eq") == 0) return cmp == 0;
+        if (strcmp(op, "-ne") == 0) return cmp != 0;
+        if (strcmp(op, "-lt") == 0) return cmp < 0;
+        if (strcmp(op, "-le") == 0) return cmp <= 0;
+        if (strcmp(op, "-gt") == 0) return cmp > 0;
+        return cmp >= 0;
+    }
+
+    if (file_op) {
+        if (l_is_l || r_is_l)
+            test_syntax_error("%s does not accept -l", op);
+        const char *a = test_argv[op_pos - 1];
+        const char *b = test_argv[op_pos + 1];
+        test_pos += 3;
+
+        if (op[1] == 'n')
+            return test_newer(a, b);
+        if (op[1] == 'o')
+            return test_newer(b, a);
+        struct stat sa, sb;
+        return stat(a, &sa) == 0 && stat(b, &sb) == 0 &&
+               sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+    }
+
+    int equal = strcmp(test_argv[test_pos], test_argv[test_pos + 2]) == 0;
+    test_pos += 3;
+    return op[0] == '!' ? !equal : equal;
 }
 
+static int test_or(void);
+static int test_posix(int nargs);
+
 /**
- * @brief Intenta ejecutar un comando built-in
- * @param args Argumentos del comando (args[0] es el nombre del comando)
- * @return 1 si se ejecutó un comando built-in, 0 si no
+ * @brief Evalúa un término de test (negación, paréntesis o primario)
+ * @return 1 si el término es verdadero, 0 si no
+ */
+static int test_term(void) {
+    int negated = 0;
+    int value;
+
+    if (test_pos >= test_argc)
+        test_beyond();
+
+    while (test_pos < test_argc && strcmp(test_argv[test_pos], "!") == 0) {
+        test_advance(1);
+        negated = !negated;
+    }
+
+    const char *arg = test_argv[test_pos];
+    int left = test_argc - test_pos;
+
+    if (strcmp(arg, "(") == 0) {
+        test_advance(1);
+        // Con hasta cuatro argumentos antes del ")" se aplican las reglas POSIX
+        int nargs;
+        for (nargs = 1; test_pos + nargs < test_argc && strcmp(test_argv[test_pos + nargs], ")") != 0; nargs++) {
+            if (nargs == 4) {
+                nargs = test_argc - test_pos;
+                break;
+            }
+        }
+        value = test_posix(nargs);
+        if (test_pos >= test_argc)
+            test_syntax_error("%s expected", quote(")"));
+        if (strcmp(test_argv[test_pos], ")") != 0)
+            test_syntax_error("%s expected, found %s", quote(")"), quote(test_argv[test_pos]));
+        test_advance(0);
+    } else if (left >= 4 && strcmp(arg, "-l") == 0 && test_is_binary_op(test_argv[test_pos + 2])) {
+        value = test_binary(1);
+    } else if (left >= 3 && test_is_binary_op(test_argv[test_pos + 1])) {
+        value = test_binary(0);
+    } else if (arg[0] == '-' && arg[1] != '\0' && arg[2] == '\0') {
+        if (!test_is_unary_op(arg))
+            test_syntax_error("%s: unary operator expected", quote(arg));
+        value = test_unary();
+    } else {
+        value = arg[0] != '\0';
+        test_advance(0);
+    }
+
+    return negated ^ value;
+}
+
+/**
+ * @brief Evalúa una conjunción (-a) de términos
+ * @return 1 si la expresión es verdadera, 0 si no
+ */
+static int test_and(void) {
+    int value = 1;
+    for (;;) {
+        value &= test_term();
+        if (test_pos >= test_argc || strcmp(test_argv[test_pos], "-a") != 0)
+            return value;
+        test_advance(0);
+    }
+}
+
+/**
+ * @brief Evalúa una disyunción (-o) de conjunciones
+ * @return 1 si la expresión es verdadera, 0 si no
+ */
+static int test_or(void) {
+    int value = 0;
+    for (;;) {
+        value |= test_and();
+        if (test_pos >= test_argc || strcmp(test_argv[test_pos], "-o") != 0)
+            return value;
+        test_advance(0);
+    }
+}
+
+/**
+ * @brief Evalúa una expresión con un solo argumento (cierta si no es vacío)
+ * @return 1 si la expresión es verdadera, 0 si no
+ */
+static int test_one_argument(void) {
+    return test_argv[test_pos++][0] != '\0';
+}
+
+/**
+ * @brief Evalúa una expresión de dos argumentos ("! x" o "-op x")
+ * @return 1 si la expresión es verdadera, 0 si no
+ */
+static int test_two_arguments(void) {
+    const char *arg = test_argv[test_pos];
+
+    if (strcmp(arg, "!") == 0) {
+        test_advance(0);
+        return !test_one_argument();
+    }
+    if (arg[0] == '-' && arg[1] != '\0' && arg[2] == '\0') {
+        if (!test_is_unary_op(arg))
+            test_syntax_error("%s: unary operator expected", quote(arg));
+        return test_unary();
+    }
+    test_beyond();
+    return 0;
+}
+
+/**
+ * @brief Evalúa una expresión de tres argumentos
+ * @return 1 si la expresión es verdadera, 0 si no
+ */
+static int test_three_arguments(void) {
+    int value;
+
+    if (test_is_binary_op(test_argv[test_pos + 1]))
+        return test_binary(0);
+    if (strcmp(test_argv[test_pos], "!") == 0) {
+        test_advance(1);
+        return !test_two_arguments();
+    }
+    if (strcmp(test_argv[test_pos], "(") == 0 && strcmp(test_argv[test_pos + 2], ")") == 0) {
+        test_advance(0);
+        value = test_one_argument();
+        test_advance(0);
+        return value;
+    }
+    if (strcmp(test_argv[test_pos + 1], "-a") != 0 && strcmp(test_argv[test_pos + 1], "-o") != 0)
+        test_syntax_error("%s: binary operator expected", quote(test_argv[test_pos + 1]));
+    return test_or();
+}
+
+/**
+ * @brief Evalúa los siguientes argumentos según las reglas POSIX por número de argumentos
+ * @param nargs Número de argumentos de la expresión
+ * @return 1 si la expresión es verdadera, 0 si no
+ *
+ * Con hasta cuatro argumentos la interpretación depende solo de la
+ * cantidad, igual que en coreutils; con más se usa el analizador general.
+ */
+static int test_posix(int nargs) {
+    int value;
+
+    switch (nargs) {
+        case 1:
+            return test_one_argument();
+        case 2:
+            return test_two_arguments();
+        case 3:
+            return test_three_arguments();
+        case 4:
+            if (strcmp(test_argv[test_pos], "!") == 0) {
+                test_advance(1);
+                return !test_three_arguments();
+            }
+            if (strcmp(test_argv[test_pos], "(") == 0 && strcmp(test_argv[test_pos + 3], ")") == 0) {
+                test_advance(0);
+                value = test_two_arguments();
+                test_advance(0);
+                return value;
+            }
+            break;
+    }
+
+    if (test_pos >= test_argc)
+        test_beyond();
+    return test_or();
+}
+
+/**
+ * @brief Implementa los comandos built-in test y [
+ * @param args Argumentos del comando (expresión a evaluar)
+ *
+ * El estado de salida es 0 si la expresión es verdadera, 1 si es falsa
+ * y 2 si hay un error de sintaxis, como en coreutils. "[ --help" y
+ * "[ --version" muestran el texto del binario de coreutils.
+ */
+void cmd_test(char **args) {
+    int argc = 0;
+    while (args[argc] != NULL)
+        argc++;
+
+    test_argv = args;
+    test_argc = argc;
+    test_pos = 1;
+
+    if (setjmp(test_error) != 0) {
+        last_command_status = 2;
+        return;
+    }
+
+    if (strcmp(args[0], "[") == 0) {
+        if (is_info_option(args)) {
+            run_coreutils(args);
+            return;
+        }
+        if (argc < 2 || strcmp(args[argc - 1], "]") != 0)
+            test_syntax_error("missing %s", quote("]"));
+        test_argc--;
+    }
+
+    if (test_pos >= test_argc) {
+        last_command_status = 1;
+        return;
+    }
+
+    int value = test_posix(test_argc - 1);
+    if (test_pos != test_argc)
+        test_syntax_error("extra argument %s", quote(test_argv[test_pos]));
+    last_command_status = !value;
+}
+
+// Estado de la ejecución de printf
+static int printf_status;
+static int printf_stop;
+
+/**
+ * @brief Reporta un error de printf
+ * @param stop Si es 1, printf termina sin procesar nada más
+ * @param fmt Formato del mensaje, seguido de sus argumentos
+ *
+ * Como error() en coreutils, vacía antes la salida estándar para que
+ * el mensaje aparezca después de lo ya escrito.
+ */
+static void printf_error(int stop, const char *fmt, ...) {
+    va_list ap;
+
+    fflush(stdout);
+    fprintf(stderr, "printf: ");
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    printf_status = 1;
+    printf_stop |= stop;
+}
+
+/**
+ * @brief Convierte un dígito hexadecimal a su valor
+ * @param c Dígito ('0'-'9', 'a'-'f' o 'A'-'F')
+ * @return Valor del dígito
+ */
+static int hex_value(char c) {
+    return isdigit((unsigned char)c) ? c - '0' : tolower((unsigned char)c) - 'a' + 10;
+}
+
+/**
+ * @brief Imprime un carácter Unicode de un escape \u o \U de printf
+ * @param code Punto de código
+ *
+ * Con un locale UTF-8 se escribe codificado; en otro caso, como hace
+ * coreutils cuando no puede convertirlo, se escribe de nuevo como escape.
+ */
+static void printf_unicode(unsigned int code) {
+    locale_t loc = utf8_locale();
+
+    if (loc != (locale_t)0 && code <= 0x10ffff) {
+        if (code < 0x80) {
+            putchar(code);
+        } else if (code < 0x800) {
+            putchar(0xc0 | (code >> 6));
+            putchar(0x80 | (code & 0x3f));
+        } else if (code < 0x10000) {
+            putchar(0xe0 | (code >> 12));
+            putchar(0x80 | ((code >> 6) & 0x3f));
+            putchar(0x80 | (code & 0x3f));
+        } else {
+            putchar(0xf0 | (code >> 18));
+            putchar(0x80 | ((code >> 12) & 0x3f));
+            putchar(0x80 | ((code >> 6) & 0x3f));
+            putchar(0x80 | (code & 0x3f));
+        }
+    } else if (code < 0x80) {
+        putchar(code);
+    } else {
+        printf(code < 0x10000 ? "\\u%04X" : "\\U%08X", code);
+    }
+
+    if (loc != (locale_t)0)
+        freelocale(loc);
+}
+
+/**
+ * @brief Imprime una secuencia de escape de printf
+ * @param p Puntero al carácter que sigue a la barra invertida
+ * @param octal_0 Si es 1, los octales llevan un 0 inicial (modo %b)
+ * @return Número de caracteres consumidos después de la barra invertida
+ */
+static int printf_escape(const char *p, int octal_0) {
+    const char *start = p;
+    int value = 0;
+
+    if (*p == 'x') {
+        int digits = 0;
+        for (p++; digits < 2 && isxdigit((unsigned char)*p); p++, digits++)
+            value = value * 16 + hex_value(*p);
+        if (digits == 0) {
+            printf_error(1, "missing hexadecimal number in escape");
+            return p - start;
+        }
+        putchar(value);
+    } else if (*p == 'u' || *p == 'U') {
+        char letter = *p++;
+        int digits = letter == 'u' ? 4 : 8;
+        unsigned int code = 0;
+        for (int i = 0; i < digits; i++, p++) {
+            if (!isxdigit((unsigned char)*p)) {
+                printf_error(1, "missing hexadecimal number in escape");
+                return p - start;
+            }
+            code = code * 16 + hex_value(*p);
+        }
+        // Los mismos nombres de carácter que rechaza C99 (y coreutils)
+        if ((code <= 0x9f && code != 0x24 && code != 0x40 && code != 0x60) ||
+            (code >= 0xd800 && code <= 0xdfff)) {
+            printf_error(1, "invalid universal character name \\%c%0*x", letter, digits, code);
+            return p - start;
+        }
+        printf_unicode(code);
+    } else if (*p >= '0' && *p <= '7') {
+        int digits = 0;
+        if (octal_0 && *p == '0')
+            p++;
+        for (; digits < 3 && *p >= '0' && *p <= '7'; p++, digits++)
+            value = value * 8 + (*p - '0');
+        putchar(value);
+    } else if (*p != '\0' && strchr("\"\\abcefnrtv", *p)) {
+        switch (*p++) {
+            case 'a': putchar('\a'); break;
+            case 'b': putchar('\b'); break;
+            case 'c': printf_stop = 1; break;
+            case 'e': putchar('\033'); break;
+            case 'f': putchar('\f'); break;
+            case 'n': putchar('\n'); break;
+            case 'r': putchar('\r'); break;
+            case 't': putchar('\t'); break;
+            case 'v': putchar('\v'); break;
+            default: putchar(p[-1]); break;
+        }
+    } else {
+        putchar('\\');
+        if (*p != '\0')
+            putchar(*p++);
+    }
+
+    return p - start;
+}
+
+/**
+ * @brief Verifica que un argumento numérico de printf se convirtió entero
+ * @param s Argumento original
+ * @param end Posición donde terminó la conversión
+ */
+static void printf_check_numeric(const char *s, const char *end) {
+    if (errno != 0)
+        printf_error(0, "%s: %s", quote(s), strerror(errno));
+    else if (end == s && *end != '\0')
+        printf_error(0, "%s: expected a numeric value", quote(s));
+    else if (*end != '\0')
+        printf_error(0, "%s: value not completely converted", quote(s));
+}
+
+/**
+ * @brief Convierte un argumento de printf a entero con signo
+ * @param s Argumento a convertir
+ * @return Valor convertido
+ *
+ * Si el argumento empieza con comilla simple o doble, el valor es el
+ * código del carácter que la sigue.
+ */
+static long long printf_signed(const char *s) {
+    if (s[0] == '\'' || s[0] == '"')
+        return (unsigned char)s[1];
+    char *end;
+    errno = 0;
+    long long value = strtoll(s, &end, 0);
+    printf_check_numeric(s, end);
+    return value;
+}
+
+/**
+ * @brief Convierte un argumento de printf a entero sin signo
+ * @param s Argumento a convertir
+ * @return Valor convertido
+ */
+static unsigned long long printf_unsigned(const char *s) {
+    if (s[0] == '\'' || s[0] == '"')
+        return (unsigned char)s[1];
+    char *end;
+    errno = 0;
+    unsigned long long value = strtoull(s, &end, 0);
+    printf_check_numeric(s, end);
+    return value;
+}
+
+/**
+ * @brief Convierte un argumento de printf a punto flotante
+ * @param s Argumento a convertir
+ * @return Valor convertido
+ */
+static long double printf_float(const char *s) {
+    if (s[0] == '\'' || s[0] == '"')
+        return (unsigned char)s[1];
+    char *end;
+    errno = 0;
+    long double value = strtold(s, &end);
+    printf_check_numeric(s, end);
+    return value;
+}
+
+/**
+ * @brief Indica si un carácter debe ir entre comillas al citar para la shell
+ * @param c Carácter a verificar
+ * @param first 1 si es el primer carácter de la cadena
+ * @return 1 si necesita comillas, 0 si no
+ */
+static int printf_needs_quote(unsigned char c, int first) {
+    if (isalnum(c) || strchr("%+,-./:@_", c) != NULL)
+        return c == '\0';
+    if (c == '~' || c == '#')
+        return first;
+    return 1;
+}
+
+/**
+ * @brief Imprime un argumento citado para poder reutilizarse en la shell (%q)
+ * @param arg Argumento a citar
+ *
+ * Sigue el estilo de coreutils: sin comillas si no hace falta, comillas
+ * dobles si solo contiene comillas simples, y comillas simples con
+ * secuencias $'...' para los caracteres de control en el resto de casos.
+ */
+static void printf_quote(const char *arg) {
+    int needs_quote = arg[0] == '\0';
+    int single_quote = 0;
+    int double_compatible = 1;
+
+    for (int i = 0; arg[i] != '\0'; i++) {
+        unsigned char c = arg[i];
+        if (printf_needs_quote(c, i == 0))
+            needs_quote = 1;
+        if (c == '\'')
+            single_quote = 1;
+        if (c < 32 || c >= 127 || strchr("$`\\\"!", c) != NULL)
+            double_compatible = 0;
+    }
+
+    if (!needs_quote) {
+        fputs(arg, stdout);
+        return;
+    }
+    if (single_quote && double_compatible) {
+        printf("\"%s\"", arg);
+        return;
+    }
+
+    int open = 1;
+    putchar('\'');
+    for (const unsigned char *p = (const unsigned char *)arg; *p != '\0'; p++) {
+        if (*p < 32 || *p >= 127) {
+            if (open)
+                putchar('\'');
+            fputs("$'", stdout);
+            for (; *p != '\0' && (*p < 32 || *p >= 127); p++) {
+                const char *esc = strchr("\aa\bb\tt\nn\vv\ff\rr", *p);
+                if (*p != '\0' && esc != NULL)
+                    printf("\\%c", esc[1]);
+                else
+                    printf("\\%03o", *p);
+            }
+            putchar('\'');
+            open = 0;
+            p--;
+            continue;
+        }
+        if (!open) {
+            putchar('\'');
+            open = 1;
+        }
+        if (*p == '\'')
+            fputs("'\\''", stdout);
+        else
+            putchar(*p);
+    }
+    if (open)
+        putchar('\'');
+}
+
+/**
+ * @brief Imprime el formato una vez consumiendo los argumentos necesarios
+ * @param format Cadena de formato
+ * @param argv Argumentos disponibles (terminados en NULL)
+ * @return Número de argumentos consumidos
+ */
+static int printf_format(const char *format, char **argv) {
+    int used = 0;
+
+    for (const char *p = format; *p != '\0' && !printf_stop; p++) {
+        if (*p == '\\') {
+            p += printf_escape(p + 1, 0);
+            continue;
+        }
+        if (*p != '%') {
+            putchar(*p);
+            continue;
+        }
+
+        const char *spec_start = p++;
+        if (*p == '%') {
+            putchar('%');
+            continue;
+        }
+
+        // Construir la especificación con el ancho y la precisión ya resueltos
+        char spec[64];
+        int len = 0;
+        spec[len++] = '%';
+        while (*p != '\0' && strchr("-+ #0'", *p) && len < 16)
+            spec[len++] = *p++;
+        if (*p == '*') {
+            p++;
+            const char *arg = argv[used] ? argv[used++] : "0";
+            len += snprintf(spec + len, 24, "%d", (int)printf_signed(arg));
+        } else {
+            while (isdigit((unsigned char)*p) && len < 40)
+                spec[len++] = *p++;
+        }
+        if (*p == '.') {
+            spec[len++] = *p++;
+            if (*p == '*') {
+                p++;
+                const char *arg = argv[used] ? argv[used++] : "0";
+                len += snprintf(spec + len, 12, "%d", (int)printf_signed(arg));
+            } else {
+                while (isdigit((unsigned char)*p) && len < 52)
+                    spec[len++] = *p++;
+            }
+        }
+        while (*p != '\0' && strchr("hlLjzt", *p))
+            p++;
+
+        char conv = *p;
+        const char *arg = argv[used] ? argv[used] : NULL;
+        if (conv != '\0' && strchr("bcqsdiouxXaAeEfFgG", conv) && arg != NULL)
+            used++;
+
+        // %b y %q no admiten opciones, ancho ni precisión
+        if ((conv == 'b' || conv == 'q') && len > 1) {
+            printf_error(1, "%.*s: invalid conversion specification", (int)(p - spec_start + 1), spec_start);
+            return used;
+        }
+
+        switch (conv) {
+            case 'b':
+                if (arg != NULL) {
+                    for (const char *q = arg; *q != '\0' && !printf_stop; q++) {
+                        if (*q == '\\')
+                            q += printf_escape(q + 1, 1);
+                        else
+                            putchar(*q);
+                    }
+                }
+                break;
+            case 'q':
+                if (arg != NULL)
+                    printf_quote(arg);
+                break;
+            case 's':
+            case 'c':
+                spec[len++] = conv;
+                spec[len] = '\0';
+                if (conv == 's')
+                    printf(spec, arg ? arg : "");
+                else
+                    printf(spec, arg ? arg[0] : '\0');
+                break;
+            case 'd':
+            case 'i':
+                spec[len++] = 'l';
+                spec[len++] = 'l';
+                spec[len++] = conv;
+                spec[len] = '\0';
+                printf(spec, arg ? printf_signed(arg) : 0LL);
+                break;
+            case 'o':
+            case 'u':
+            case 'x':
+            case 'X':
+                spec[len++] = 'l';
+                spec[len++] = 'l';
+                spec[len++] = conv;
+                spec[len] = '\0';
+                printf(spec, arg ? printf_unsigned(arg) : 0ULL);
+                break;
+            case 'a': case 'A': case 'e': case 'E':
+            case 'f': case 'F': case 'g': case 'G':
+                spec[len++] = 'L';
+                spec[len++] = conv;
+                spec[len] = '\0';
+                printf(spec, arg ? printf_float(arg) : 0.0L);
+                break;
+            default:
+                printf_error(1, "%.*s: invalid conversion specification",
+                             (int)(p - spec_start + (conv != '\0')), spec_start);
+                return used;
+        }
+    }
+
+    return used;
+}
+
+/**
+ * @brief Implementa el comando built-in printf
+ * @param args Argumentos del comando (args[1] es el formato)
+ *
+ * El formato se reutiliza mientras queden argumentos por consumir,
+ * igual que en coreutils. Como allí, un "--" inicial se salta y un
+ * --help o --version como único argumento muestran la ayuda o la versión.
+ */
+void cmd_printf(char **args) {
+    if (is_info_option(args)) {
+        run_coreutils(args);
+        return;
+    }
+
+    char **argv = args + 1;
+    if (argv[0] != NULL && strcmp(argv[0], "--") == 0)
+        argv++;
+    if (argv[0] == NULL) {
+        fprintf(stderr, "printf: missing operand\n");
+        fprintf(stderr, "Try 'printf --help' for more information.\n");
+        last_command_status = 1;
+        return;
+    }
+
+    const char *format = *argv++;
+    int used;
+
+    printf_status = 0;
+    printf_stop = 0;
+
+    do {
+        used = printf_format(format, argv);
+        argv += used;
+    } while (used > 0 && *argv != NULL && !printf_stop);
+
+    fflush(stdout);
+    if (*argv != NULL && !printf_stop)
+        fprintf(stderr, "printf: warning: ignoring excess arguments, starting with %s\n", quote(*argv));
+
+    last_command_status = printf_status;
+}
+
+/**
+ * @brief Reporta un error de uso de basename, dirname o sleep
+ * @param name Nombre del comando
+ * @param fmt Formato del mensaje, seguido de sus argumentos
+ */
+static void usage_error(const char *name, const char *fmt, ...) {
+    va_list ap;
+
+    fprintf(stderr, "%s: ", name);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fprintf(stderr, "\nTry '%s --help' for more information.\n", name);
+    last_command_status = 1;
+}
+
+/**
+ * @brief Opción larga de un built-in, como struct option de getopt_long
+ */
+typedef struct {
+    const char *name; /**< Nombre sin los guiones */
+    int has_arg;      /**< 1 si la opción necesita un argumento */
+    char val;         /**< Opción corta equivalente, o 0 para --help y --version */
+} LongOption;
+
+/**
+ * @brief Estado del análisis de opciones de un built-in
+ */
+typedef struct {
+    char **args;       /**< Argumentos del comando */
+    int index;         /**< Siguiente argumento por analizar */
+    const char *next;  /**< Resto de un grupo de opciones cortas ("-az") */
+    const char *value; /**< Argumento de la última opción */
+    char **operands;   /**< Operandos encontrados, terminados en NULL al acabar */
+    int operand_count; /**< Número de operandos encontrados */
+    int permute;       /**< 1 si puede haber opciones después de los operandos */
+} OptionParser;
+
+/**
+ * @brief Prepara el análisis de opciones de un built-in
+ * @param p Estado del análisis
+ * @param args Argumentos del comando
+ * @param permute 1 para buscar opciones también tras los operandos (salvo con POSIXLY_CORRECT)
+ *
+ * El llamador libera p->operands al terminar.
+ */
+static void option_parser_init(OptionParser *p, char **args, int permute) {
+    int argc = 0;
+    while (args[argc] != NULL)
+        argc++;
+
+    p->args = args;
+    p->index = 1;
+    p->next = NULL;
+    p->value = NULL;
+    p->operands = malloc(argc * sizeof(char *));
+    p->operand_count = 0;
+    p->permute = permute && getenv("POSIXLY_CORRECT") == NULL;
+}
+
+/**
+ * @brief Analiza una opción larga (el texto tras "--")
+ * @param p Estado del análisis
+ * @param name Nombre del comando (para los mensajes de error)
+ * @param text Opción tal como se escribió, con el "=valor" si lo tiene
+ * @param longopts Opciones largas, terminadas en {NULL}
+ * @return Valor de la opción, o '?' si es un error (ya reportado)
+ *
+ * Como getopt_long, acepta cualquier prefijo que identifique una sola opción.
+ */
+static int long_option(OptionParser *p, const char *name, const char *text, const LongOption *longopts) {
+    const char *equals = strchr(text, '=');
+    size_t len = equals != NULL ? (size_t)(equals - text) : strlen(text);
+    const LongOption *found = NULL;
+    char possibilities[256] = "";
+    int matches = 0;
+
+    for (const LongOption *o = longopts; o->name != NULL; o++) {
+        if (strncmp(o->name, text, len) != 0)
+            continue;
+        if (o->name[len] == '\0') {
+            found = o;
+            matches = 1;
+            break;
+        }
+        if (found == NULL)
+            found = o;
+        matches++;
+        size_t used = strlen(possibilities);
+        snprintf(possibilities + used, sizeof(possibilities) - used, " '--%s'", o->name);
+    }
+
+    if (matches > 1) {
+        usage_error(name, "option '--%s' is ambiguous; possibilities:%s", text, possibilities);
+        return '?';
+    }
+    if (found == NULL) {
+        usage_error(name, "unrecognized option '--%s'", text);
+        return '?';
+    }
+    if (equals != NULL) {
+        if (!found->has_arg) {
+            usage_error(name, "option '--%s' doesn't allow an argument", found->name);
+            return '?';
+        }
+        p->value = equals + 1;
+    } else if (found->has_arg) {
+        if (p->args[p->index] == NULL) {
+            usage_error(name, "option '--%s' requires an argument", found->name);
+            return '?';
+        }
+        p->value = p->args[p->index++];
+    }
+    return found->val;
+}
+
+/**
+ * @brief Devuelve la siguiente opción de un built-in, como getopt_long de glibc
+ * @param p Estado del análisis
+ * @param name Nombre del comando (para los mensajes de error)
+ * @param shortopts Opciones cortas ("s:" si la opción necesita un argumento)
+ * @param longopts Opciones largas, terminadas en {NULL}
+ * @return Letra de la opción, 0 para --help y --version, '?' si hay un
+ *         error (ya reportado) o -1 si no quedan opciones
+ *
+ * El argumento de la opción queda en p->value. Al devolver -1 los
+ * operandos quedan en p->operands, en el orden en que aparecieron.
+ */
+static int next_option(OptionParser *p, const char *name, const char *shortopts, const LongOption *longopts) {
+    char **args = p->args;
+
+    if (p->next == NULL) {
+        for (;;) {
+            const char *arg = args[p->index];
+            if (arg != NULL && arg[0] == '-' && arg[1] != '\0' && strcmp(arg, "--") != 0)
+                break;
+            if (arg == NULL || !p->permute || strcmp(arg, "--") == 0) {
+                p->index += arg != NULL && strcmp(arg, "--") == 0;
+                while (args[p->index] != NULL)
+                    p->operands[p->operand_count++] = args[p->index++];
+                p->operands[p->operand_count] = NULL;
+                return -1;
+            }
+            p->operands[p->operand_count++] = args[p->index++];
+        }
+        const char *arg = args[p->index++];
+        if (arg[1] == '-')
+            return long_option(p, name, arg + 2, longopts);
+        p->next = arg + 1;
+    }
+
+    char c = *p->next++;
+    const char *spec = c != ':' ? strchr(shortopts, c) : NULL;
+    if (*p->next == '\0')
+        p->next = NULL;
+    if (spec == NULL) {
+        usage_error(name, "invalid option -- '%c'", c);
+        return '?';
+    }
+    if (spec[1] == ':') {
+        if (p->next != NULL) {
+            p->value = p->next;
+            p->next = NULL;
+        } else if (args[p->index] != NULL) {
+            p->value = args[p->index++];
+        } else {
+            usage_error(name, "option requires an argument -- '%c'", c);
+            return '?';
+        }
+    }
+    return c;
+}
+
+/**
+ * @brief Imprime el último componente de una ruta
+ * @param name Ruta a procesar
+ * @param suffix Sufijo a eliminar (puede ser NULL)
+ * @param terminator Carácter de fin de línea ('\n' o '\0')
+ */
+static void print_basename(const char *name, const char *suffix, char terminator) {
+    size_t len = strlen(name);
+
+    // Una ruta compuesta solo de barras se reduce a "/"
+    if (len > 0 && strspn(name, "/") == len) {
+        printf("/%c", terminator);
+        return;
+    }
+
+    while (len > 1 && name[len - 1] == '/')
+        len--;
+    size_t start = len;
+    while (start > 0 && name[start - 1] != '/')
+        start--;
+    len -= start;
+
+    if (suffix != NULL) {
+        size_t suffix_len = strlen(suffix);
+        if (suffix_len < len && strncmp(name + start + len - suffix_len, suffix, suffix_len) == 0)
+            len -= suffix_len;
+    }
+
+    printf("%.*s%c", (int)len, name + start, terminator);
+}
+
+/**
+ * @brief Implementa el comando built-in basename
+ * @param args Argumentos del comando (rutas y sufijo opcional)
+ *
+ * Acepta las opciones -a, -s SUFIJO y -z de coreutils y sus nombres
+ * largos; --help y --version se pasan al binario de coreutils.
+ */
+void cmd_basename(char **args) {
+    static const LongOption longopts[] = {
+        {"multiple", 0, 'a'},
+        {"suffix", 1, 's'},
+        {"zero", 0, 'z'},
+        {"help", 0, 0},
+        {"version", 0, 0},
+        {NULL}
+    };
+    const char *suffix = NULL;
+    int multiple = 0;
+    char terminator = '\n';
+    OptionParser p;
+    int c;
+
+    // Como "+as:z" en getopt: las opciones terminan en el primer operando
+    option_parser_init(&p, args, 0);
+    while ((c = next_option(&p, "basename", "as:z", longopts)) != -1) {
+        switch (c) {
+            case 'a':
+                multiple = 1;
+                break;
+            case 's':
+                suffix = p.value;
+                multiple = 1;
+                break;
+            case 'z':
+                terminator = '\0';
+                break;
+            case 0:
+                run_coreutils(args);
+                free(p.operands);
+                return;
+            default:
+                free(p.operands);
+                return;
+        }
+    }
+
+    char **names = p.operands;
+    if (names[0] == NULL) {
+        usage_error("basename", "%s", "missing operand");
+    } else if (multiple) {
+        for (int i = 0; names[i] != NULL; i++)
+            print_basename(names[i], suffix, terminator);
+        last_command_status = 0;
+    } else if (names[1] != NULL && names[2] != NULL) {
+        usage_error("basename", "extra operand %s", quote(names[2]));
+    } else {
+        print_basename(names[0], names[1], terminator);
+        last_command_status = 0;
+    }
+    free(p.operands);
+}
+
+/**
+ * @brief Imprime una ruta sin su último componente
+ * @param name Ruta a procesar
+ * @param terminator Carácter de fin de línea ('\n' o '\0')
+ */
+static void print_dirname(const char *name, char terminator) {
+    size_t len = strlen(name);
+
+    // Quitar barras finales, el último componente y las barras que lo preceden
+    while (len > 1 && name[len - 1] == '/')
+        len--;
+    while (len > 0 && name[len - 1] != '/')
+        len--;
+
+    if (len == 0) {
+        printf(".%c", terminator);
+        return;
+    }
+
+    while (len > 1 && name[len - 1] == '/')
+        len--;
+    printf("%.*s%c", (int)len, name, terminator);
+}
+
+/**
+ * @brief Implementa el comando built-in dirname
+ * @param args Argumentos del comando (rutas a procesar)
+ *
+ * Acepta -z (--zero) en cualquier posición antes de "--"; --help y
+ * --version se pasan al binario de coreutils.
+ */
+void cmd_dirname(char **args) {
+    static const LongOption longopts[] = {
+        {"zero", 0, 'z'},
+        {"help", 0, 0},
+        {"version", 0, 0},
+        {NULL}
+    };
+    char terminator = '\n';
+    OptionParser p;
+    int c;
+
+    option_parser_init(&p, args, 1);
+    while ((c = next_option(&p, "dirname", "z", longopts)) != -1) {
+        if (c == 'z') {
+            terminator = '\0';
+            continue;
+        }
+        if (c == 0)
+            run_coreutils(args);
+        free(p.operands);
+        return;
+    }
+
+    if (p.operands[0] == NULL) {
+        usage_error("dirname", "%s", "missing operand");
+    } else {
+        for (int i = 0; p.operands[i] != NULL; i++)
+            print_dirname(p.operands[i], terminator);
+        last_command_status = 0;
+    }
+    free(p.operands);
+}
+
+/**
+ * @brief Implementa el comando built-in sleep
+ * @param args Argumentos del comando (duraciones con sufijo s, m, h o d)
+ *
+ * Las duraciones se suman como en coreutils. La espera se puede
+ * interrumpir con Ctrl+C, en cuyo caso el comando termina con error.
+ * --help y --version se pasan al binario de coreutils.
+ */
+void cmd_sleep(char **args) {
+    double seconds = 0;
+
+    static const LongOption longopts[] = {
+        {"help", 0, 0},
+        {"version", 0, 0},
+        {NULL}
+    };
+    OptionParser p;
+
+    // sleep no tiene más opciones que --help y --version, en cualquier posición antes de "--"
+    option_parser_init(&p, args, 1);
+    int c = next_option(&p, "sleep", "", longopts);
+    if (c != -1) {
+        if (c == 0)
+            run_coreutils(args);
+        free(p.operands);
+        return;
+    }
+
+    if (args[1] == NULL) {
+        usage_error("sleep", "%s", "missing operand");
+        free(p.operands);
+        return;
+    }
+
+    for (int i = 0; p.operands[i] != NULL; i++) {
+        const char *arg = p.operands[i];
+        char *end;
+        errno = 0;
+        double value = strtod(arg, &end);
+        double multiplier = 1;
+
+        if (end != arg && *end != '\0' && end[1] == '\0') {
+            switch (*end) {
+                case 's': multiplier = 1; end++; break;
+                case 'm': multiplier = 60; end++; break;
+                case 'h': multiplier = 60 * 60; end++; break;
+                case 'd': multiplier = 60 * 60 * 24; end++; break;
+            }
+        }
+        if (end == arg || *end != '\0' || value < 0 || isnan(value)) {
+            fprintf(stderr, "sleep: invalid time interval %s\n", quote(arg));
+            fprintf(stderr, "Try 'sleep --help' for more information.\n");
+            last_command_status = 1;
+            free(p.operands);
+            return;
+        }
+        seconds += value * multiplier;
+    }
+    free(p.operands);
+
+    // La salida pendiente debe verse antes de la espera
+    fflush(stdout);
+
+    // Marcar que hay un comando en primer plano para que Ctrl+C no redibuje el prompt
+    foreground_process_running = 1;
+    last_command_status = 0;
+
+    while (seconds > 0) {
+        double chunk = seconds > 86400 ? 86400 : seconds;
+        struct timespec req, rem;
+        req.tv_sec = (time_t)chunk;
+        req.tv_nsec = (long)((chunk - req.tv_sec) * 1e9);
+        seconds -= chunk;
+
+        while (nanosleep(&req, &rem) != 0) {
+            if (errno != EINTR || last_command_status != 0) {
+                last_command_status = 1;
+                seconds = 0;
+                break;
+            }
+            req = rem;
+        }
+    }
+
+    foreground_process_running = 0;
+}
+
+/**
+ * @brief Implementa el comando built-in enable
+ * @param args Argumentos del comando (-n desactiva los built-ins indicados)
+ *
+ * Sin argumentos lista el estado de todos los built-ins. Un built-in
+ * desactivado se ejecuta como binario externo desde el PATH.
+ */
+void cmd_enable(char **args) {
+    int disable = 0;
+    int i = 1;
+
+    if (args[i] != NULL && strcmp(args[i], "-n") == 0) {
+        disable = 1;
+        i++;
+    }
+
+    last_command_status = 0;
+
+    if (args[i] == NULL) {
+        for (int j = 0; j < num_builtin_commands; j++) {
+            if (builtin_commands[j].disabled == disable)
+                printf("enable %s%s\n", disable ? "-n " : "", builtin_commands[j].name);
+        }
+        return;
+    }
+
+    for (; args[i] != NULL; i++) {
+        int found = 0;
+        for (int j = 0; j < num_builtin_commands; j++) {
+            if (strcmp(args[i], builtin_commands[j].name) == 0) {
+                builtin_commands[j].disabled = disable;
+                found = 1;
+            }
+        }
+        if (!found) {
+            fprintf(stderr, "enable: %s: no es un built-in\n", args[i]);
+            last_command_status = 1;
+        }
+    }
+}
+
+// Variables exportadas recogidas para listarlas ordenadas (NULL si falló la memoria)
+static const ShellVar **export_list;
+static int export_count;
+static int export_capacity;
+
+/**
+ * @brief Añade una variable exportada a la lista de export, ampliándola si hace falta
+ * @param var Variable a considerar
+ */
+static void collect_exported(const ShellVar *var) {
+    if (!var->exported || export_list == NULL)
+        return;
+    if (export_count == export_capacity) {
+        export_capacity *= 2;
+        const ShellVar **grown = realloc(export_list, sizeof(ShellVar *) * export_capacity);
+        if (grown == NULL) {
+            free(export_list);
+            export_list = NULL;
+            return;
+        }
+        export_list = grown;
+    }
+    export_list[export_count++] = var;
+}
+
+/**
+ * @brief Escribe un valor entre comillas dobles, de forma que la shell lo pueda volver a leer
+ * @param value Valor de la variable
+ */
+static void print_quoted(const char *value) {
+    putchar('"');
+    for (const char *p = value; *p; p++) {
+        if (strchr("\"$`\\", *p) != NULL)
+            putchar('\\');
+        putchar(*p);
+    }
+    putchar('"');
+}
+
+/**
+ * @brief Compara dos variables por nombre para qsort
+ * @param a Puntero a la primera variable
+ * @param b Puntero a la segunda variable
+ * @return Resultado de strcmp entre los nombres
+ */
+static int compare_vars(const void *a, const void *b) {
+    return strcmp((*(const ShellVar *const *)a)->name, (*(const ShellVar *const *)b)->name);
+}
+
+/**
+ * @brief Implementa el comando built-in export
+ * @param args Argumentos del comando (NOMBRE o NOMBRE=valor)
+ *
+ * Sin argumentos lista las variables exportadas ordenadas por nombre.
+ */
+void cmd_export(char **args) {
+    last_command_status = 0;
+
+    if (args[1] == NULL) {
+        export_capacity = 64;
+        export_list = malloc(sizeof(ShellVar *) * export_capacity);
+        export_count = 0;
+        vars_foreach(collect_exported);
+        if (export_list == NULL) {
+            perror("export");
+            last_command_status = 1;
+            return;
+        }
+        qsort(export_list, export_count, sizeof(ShellVar *), compare_vars);
+        for (int i = 0; i < export_count; i++) {
+            printf("export %s=", export_list[i]->name);
+            print_quoted(export_list[i]->value);
+            putchar('\n');
+        }
+        free(export_list);
+        return;
+    }
+
+    for (int i = 1; args[i] != NULL; i++) {
+        char *eq = strchr(args[i], '=');
+        size_t len = eq ? (size_t)(eq - args[i]) : strlen(args[i]);
+
+        if (!is_valid_var_name(args[i], len)) {
+            fprintf(stderr, "export: '%s': no es un identificador válido\n", args[i]);
+            last_command_status = 1;
+            continue;
+        }
+
+        if (eq != NULL) {
+            char *name = strndup(args[i], len);
+            var_set(name, eq + 1, 1);
+            free(name);
+        } else if (!var_export(args[i])) {
+            var_set(args[i], "", 1);
+        }
+    }
+}
+
+/**
+ * @brief Implementa el comando built-in unset
+ * @param args Argumentos del comando (nombres de las variables)
+ */
+void cmd_unset(char **args) {
+    last_command_status = 0;
+    for (int i = 1; args[i] != NULL; i++) {
+        if (!is_valid_var_name(args[i], strlen(args[i]))) {
+            fprintf(stderr, "unset: '%s': no es un identificador válido\n", args[i]);
+            last_command_status = 1;
+            continue;
+        }
+        var_unset(args[i]);
+    }
+}
+
+/**
+ * @brief Implementa el comando built-in jobs
+ * @param args Argumentos del comando (no utilizados)
+ */
+void cmd_jobs(char **args) {
+    jobs_list();
+    last_command_status = 0;
+}
+
+/**
+ * @brief Busca el trabajo indicado para los built-ins de salida de trabajos
+ * @param name Nombre del built-in (para los mensajes de error)
+ * @param spec Número del trabajo o NULL para el más reciente
+ * @return Trabajo encontrado o NULL (y se marca el error)
+ */
+static Job *find_job_arg(const char *name, const char *spec) {
+    Job *job = job_find(spec);
+    if (job == NULL) {
+        if (spec == NULL)
+            fprintf(stderr, "%s: no hay trabajos\n", name);
+        else
+            fprintf(stderr, "%s: %s: no existe ese trabajo\n", name, spec);
+        last_command_status = 1;
+    }
+    return job;
+}
+
+/**
+ * @brief Implementa el comando built-in jobtail
+ * @param args Argumentos del comando ([-n líneas] [trabajo])
+ */
+void cmd_jobtail(char **args) {
+    int lines = 10;
+    int i = 1;
+
+    if (args[i] != NULL && strcmp(args[i], "-n") == 0) {
+        char *end = NULL;
+        if (args[i + 1] != NULL)
+            lines = strtol(args[i + 1], &end, 10);
+        if (end == NULL || end == args[i + 1] || *end != '\0' || lines < 0) {
+            fprintf(stderr, "jobtail: número de líneas no válido\n");
+            last_command_status = 1;
+            return;
+        }
+        i += 2;
+    }
+
+    Job *job = find_job_arg("jobtail", args[i]);
+    if (job == NULL)
+        return;
+    job_tail(job, lines);
+    last_command_status = 0;
+}
+
+/**
+ * @brief Implementa el comando built-in jobdump
+ * @param args Argumentos del comando ([trabajo])
+ */
+void cmd_jobdump(char **args) {
+    Job *job = find_job_arg("jobdump", args[1]);
+    if (job == NULL)
+        return;
+    job_dump(job);
+    last_command_status = 0;
+}
+
+/**
+ * @brief Implementa el comando built-in jobstream
+ * @param args Argumentos del comando ([trabajo])
+ */
+void cmd_jobstream(char **args) {
+    Job *job = find_job_arg("jobstream", args[1]);
+    if (job == NULL)
+        return;
+    job_stream(job);
+}
+
+/**
+ * @brief Busca un comando built-in activo
+ * @param name Nombre del comando
+ * @return Índice en builtin_commands o -1 si no existe o está desactivado
  * 
- * Busca el comando en la lista de comandos built-in y lo ejecuta si existe.
+ * Los built-ins desactivados con "enable -n" se ignoran para que se
+ * ejecute el binario externo.
  */
-int execute_builtin(char **args) {
-    if (args[0] == NULL) return 0;
+int find_active_builtin(const char *name) {
+    if (name == NULL) return -1;
     
     for (int i = 0; i < num_builtin_commands; i++) {
-        if (strcmp(args[0], builtin_commands[i].name) == 0) {
-            builtin_commands[i].func(args);
-            return 1;
-        }
+        if (!builtin_commands[i].disabled &&
+            strcmp(name, builtin_commands[i].name) == 0)
+            return i;
     }
     
-    return 0; // No es un comando built-in
+    return -1; // No es un comando built-in
 } 
\ No newline at end of file
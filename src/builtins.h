@@ -20,6 +20,10 @@ typedef struct {
     const char *name;
     /** Puntero a la función que implementa el comando */
     void (*func)(char **args);
+    /** Cambia o consulta el estado de la shell: se ejecuta en ella aunque vaya en segundo plano */
+    int shell_state;
+    /** Si es distinto de 0 se ignora el built-in y se usa el binario externo */
+    int disabled;
 } BuiltInCommand;
 
 // Declaraciones de funciones para comandos built-in
@@ -47,15 +51,99 @@ void cmd_echo(char **args);
  */
 void cmd_exit(char **args);
 
+/**
+ * @brief Implementa el comando true (termina con éxito)
+ * @param args Argumentos del comando (ignorados)
+ */
+void cmd_true(char **args);
+
+/**
+ * @brief Implementa el comando false (termina con error)
+ * @param args Argumentos del comando (ignorados)
+ */
+void cmd_false(char **args);
+
+/**
+ * @brief Implementa los comandos test y [ para evaluar expresiones
+ * @param args Argumentos del comando (expresión a evaluar)
+ */
+void cmd_test(char **args);
+
+/**
+ * @brief Implementa el comando printf para mostrar texto con formato
+ * @param args Argumentos del comando (args[1] es el formato)
+ */
+void cmd_printf(char **args);
+
+/**
+ * @brief Implementa el comando basename para quitar el directorio de una ruta
+ * @param args Argumentos del comando (rutas y sufijo opcional)
+ */
+void cmd_basename(char **args);
+
+/**
+ * @brief Implementa el comando dirname para quitar el último componente de una ruta
+ * @param args Argumentos del comando (rutas a procesar)
+ */
+void cmd_dirname(char **args);
+
+/**
+ * @brief Implementa el comando sleep para esperar un tiempo
+ * @param args Argumentos del comando (duraciones con sufijo s, m, h o d)
+ */
+void cmd_sleep(char **args);
+
+/**
+ * @brief Implementa el comando enable para activar o desactivar built-ins
+ * @param args Argumentos del comando (-n desactiva los built-ins indicados)
+ */
+void cmd_enable(char **args);
+
+/**
+ * @brief Implementa el comando export para exportar variables al entorno
+ * @param args Argumentos del comando (NOMBRE o NOMBRE=valor)
+ */
+void cmd_export(char **args);
+
+/**
+ * @brief Implementa el comando unset para eliminar variables
+ * @param args Argumentos del comando (nombres de las variables)
+ */
+void cmd_unset(char **args);
+
+/**
+ * @brief Implementa el comando jobs para listar los trabajos en segundo plano
+ * @param args Argumentos del comando (no utilizados)
+ */
+void cmd_jobs(char **args);
+
+/**
+ * @brief Implementa el comando jobtail para ver las últimas líneas de un trabajo
+ * @param args Argumentos del comando ([-n líneas] [trabajo])
+ */
+void cmd_jobtail(char **args);
+
+/**
+ * @brief Implementa el comando jobdump para ver toda la salida de un trabajo
+ * @param args Argumentos del comando ([trabajo])
+ */
+void cmd_jobdump(char **args);
+
+/**
+ * @brief Implementa el comando jobstream para seguir la salida de un trabajo
+ * @param args Argumentos del comando ([trabajo])
+ */
+void cmd_jobstream(char **args);
+
 // Array con los comandos built-in y su contador
 extern BuiltInCommand builtin_commands[];
 extern const int num_builtin_commands;
 
 /**
- * @brief Ejecuta un comando built-in si existe
- * @param args Argumentos del comando (args[0] es el nombre del comando)
- * @return 1 si se ejecutó un comando built-in, 0 si no
+ * @brief Busca un comando built-in activo
+ * @param name Nombre del comando
+ * @return Índice en builtin_commands o -1 si no existe o está desactivado
  */
-int execute_builtin(char **args);
+int find_active_builtin(const char *name);
 
 #endif // BUILTINS_H 
\ No newline at end of file
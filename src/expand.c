@@ -0,0 +1,958 @@
+/**
+ * @file expand.c
+ * @brief Implementación del análisis y la expansión de líneas de comando
+ *
+ * Este archivo contiene el analizador léxico que convierte cada palabra
+ * en un plan de expansión y la evaluación de ese plan ($VAR, $?, ~,
+ * $((...)), $(...), división en campos y glob).
+ */
+
+#include "expand.h"
+#include "vars.h"
+#include "arith.h"
+#include "vm.h"
+
+// Tamaño del búfer para leer entradas de directorio con getdents64
+#define GLOB_DIRENT_BUF (128 * 1024)
+
+// Caracteres que terminan una palabra sin comillas (además de los espacios)
+#define WORD_OPERATORS ";&|()"
+
+int expand_failed = 0;
+
+/**
+ * @brief Búfer de texto dinámico (siempre terminado en '\0')
+ */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} Buf;
+
+/**
+ * @brief Añade bytes al final de un búfer
+ * @param buf Búfer de destino
+ * @param s Bytes a añadir
+ * @param len Número de bytes
+ */
+static void buf_append(Buf *buf, const char *s, size_t len) {
+    if (buf->len + len + 1 > buf->cap) {
+        size_t cap = buf->cap ? buf->cap : 64;
+        while (buf->len + len + 1 > cap)
+            cap *= 2;
+        buf->data = realloc(buf->data, cap);
+        if (buf->data == NULL) {
+            perror("Error al asignar memoria");
+            exit(1);
+        }
+        buf->cap = cap;
+    }
+    memcpy(buf->data + buf->len, s, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+}
+
+/**
+ * @brief Añade un carácter al final de un búfer
+ * @param buf Búfer de destino
+ * @param c Carácter a añadir
+ */
+static void buf_putc(Buf *buf, char c) {
+    buf_append(buf, &c, 1);
+}
+
+/**
+ * @brief Vacía un búfer sin liberar su memoria
+ * @param buf Búfer a vaciar
+ */
+static void buf_reset(Buf *buf) {
+    buf->len = 0;
+    if (buf->data)
+        buf->data[0] = '\0';
+}
+
+/**
+ * @brief Añade un argumento a la lista (la lista toma posesión de él)
+ * @param list Lista de argumentos
+ * @param arg Argumento reservado con malloc
+ */
+void arglist_push(ArgList *list, char *arg) {
+    if (list->argc + 2 > list->cap) {
+        list->cap = list->cap ? list->cap * 2 : 16;
+        list->argv = realloc(list->argv, list->cap * sizeof(char *));
+        if (list->argv == NULL) {
+            perror("Error al asignar memoria");
+            exit(1);
+        }
+    }
+    list->argv[list->argc++] = arg;
+    list->argv[list->argc] = NULL;
+}
+
+/**
+ * @brief Libera los argumentos de la lista
+ * @param list Lista de argumentos
+ */
+void arglist_free(ArgList *list) {
+    for (int i = 0; i < list->argc; i++)
+        free(list->argv[i]);
+    free(list->argv);
+    list->argv = NULL;
+    list->argc = 0;
+    list->cap = 0;
+}
+
+/**
+ * @brief Estado intermedio mientras se analiza una palabra
+ */
+typedef struct {
+    WordPlan *word;
+    int cap;
+    Buf lit;
+    int lit_quoted;
+    int lit_active;
+} WordBuilder;
+
+/**
+ * @brief Añade un segmento a la palabra en construcción
+ * @param wb Constructor de la palabra
+ * @param type Tipo de segmento
+ * @param quoted Indica si estaba entre comillas
+ * @param text Texto del segmento
+ * @param len Longitud del texto
+ */
+static void wb_push(WordBuilder *wb, SegmentType type, int quoted, const char *text, size_t len) {
+    WordPlan *word = wb->word;
+    if (word->nsegs == wb->cap) {
+        wb->cap = wb->cap ? wb->cap * 2 : 4;
+        word->segs = realloc(word->segs, wb->cap * sizeof(Segment));
+    }
+    Segment *seg = &word->segs[word->nsegs++];
+    seg->type = type;
+    seg->quoted = quoted;
+    seg->text = strndup(text, len);
+    seg->len = len;
+    seg->hash = type == SEG_VAR ? hash_bytes(text, len) : 0;
+    seg->data = NULL;
+}
+
+/**
+ * @brief Cierra el segmento literal en curso, si lo hay
+ * @param wb Constructor de la palabra
+ */
+static void wb_flush(WordBuilder *wb) {
+    if (!wb->lit_active)
+        return;
+    wb_push(wb, SEG_LITERAL, wb->lit_quoted, wb->lit.data ? wb->lit.data : "", wb->lit.len);
+    buf_reset(&wb->lit);
+    wb->lit_active = 0;
+}
+
+/**
+ * @brief Añade un carácter literal a la palabra
+ * @param wb Constructor de la palabra
+ * @param c Carácter
+ * @param quoted Indica si estaba entre comillas o escapado
+ */
+static void wb_char(WordBuilder *wb, char c, int quoted) {
+    if (wb->lit_active && wb->lit_quoted != quoted)
+        wb_flush(wb);
+    buf_putc(&wb->lit, c);
+    wb->lit_active = 1;
+    wb->lit_quoted = quoted;
+    if (!quoted && strchr("*?[", c) != NULL)
+        wb->word->flags |= WORD_GLOB;
+}
+
+/**
+ * @brief Abre un literal entre comillas (para que "" produzca un argumento vacío)
+ * @param wb Constructor de la palabra
+ */
+static void wb_open_quoted(WordBuilder *wb) {
+    if (wb->lit_active && !wb->lit_quoted)
+        wb_flush(wb);
+    wb->lit_active = 1;
+    wb->lit_quoted = 1;
+}
+
+/**
+ * @brief Añade un segmento de expansión a la palabra
+ * @param wb Constructor de la palabra
+ * @param type Tipo de segmento
+ * @param quoted Indica si estaba entre comillas
+ * @param text Texto del segmento
+ * @param len Longitud del texto
+ * @param data Expresión o programa compilado asociado (puede ser NULL)
+ */
+static void wb_expansion(WordBuilder *wb, SegmentType type, int quoted, const char *text,
+                         size_t len, void *data) {
+    // Dentro de comillas la expansión ya produce un campo: el literal vacío abierto por " sobra
+    if (quoted && wb->lit_active && wb->lit.len == 0)
+        wb->lit_active = 0;
+    wb_flush(wb);
+    wb_push(wb, type, quoted, text, len);
+    wb->word->segs[wb->word->nsegs - 1].data = data;
+    if (!quoted && type != SEG_TILDE)
+        wb->word->flags |= WORD_SPLIT;
+}
+
+static int lex_dollar(const char **pp, WordBuilder *wb, int quoted);
+
+/**
+ * @brief Indica si una expresión aritmética necesita expandirse antes de evaluarse
+ * @param text Texto de la expresión
+ * @param len Longitud del texto
+ * @return 1 si contiene $ seguido de algo distinto de un nombre, 0 si no
+ *
+ * $NOMBRE lo resuelve el propio evaluador; $1, $#, $(...) y similares
+ * se sustituyen primero como en sh.
+ */
+static int arith_needs_expansion(const char *text, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] == '$' && (i + 1 >= len || !(isalpha((unsigned char)text[i + 1]) || text[i + 1] == '_')))
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Analiza una expansión aritmética $((...))
+ * @param pp Posición actual (apunta al $), se avanza tras la expansión
+ * @param wb Constructor de la palabra
+ * @param quoted Indica si está dentro de comillas dobles
+ * @return 1 si es correcta, 0 si está incompleta, -1 si hay error
+ */
+static int lex_arith(const char **pp, WordBuilder *wb, int quoted) {
+    const char *start = *pp + 3;
+    const char *q = start;
+    int depth = 0;
+
+    for (; *q != '\0'; q++) {
+        if (*q == '(') {
+            depth++;
+        } else if (*q == ')') {
+            if (depth == 0)
+                break;
+            depth--;
+        }
+    }
+    if (*q == '\0' || q[1] == '\0')
+        return 0;
+    if (q[1] != ')') {
+        fprintf(stderr, "dwimsh: falta '))' en la expresión aritmética\n");
+        return -1;
+    }
+
+    if (!arith_needs_expansion(start, q - start)) {
+        ArithExpr *expr = arith_compile(start, q - start);
+        if (expr == NULL)
+            return -1;
+        wb_expansion(wb, SEG_ARITH, quoted, start, q - start, expr);
+        *pp = q + 2;
+        return 1;
+    }
+
+    // El texto se analiza como si estuviera entre comillas dobles
+    WordPlan *inner = calloc(1, sizeof(WordPlan));
+    WordBuilder iwb = {inner, 0, {NULL, 0, 0}, 0, 0};
+    const char *p = start;
+    int result = 1;
+    wb_open_quoted(&iwb);
+    while (p < q && result == 1) {
+        if (*p == '$')
+            result = lex_dollar(&p, &iwb, 1);
+        else
+            wb_char(&iwb, *p++, 1);
+    }
+    wb_flush(&iwb);
+    free(iwb.lit.data);
+    if (result != 1) {
+        word_free(inner);
+        free(inner);
+        return result;
+    }
+    wb_expansion(wb, SEG_ARITH_EXPAND, quoted, start, q - start, inner);
+    *pp = q + 2;
+    return 1;
+}
+
+/**
+ * @brief Analiza una expansión que empieza con $
+ * @param pp Posición actual (apunta al $), se avanza tras la expansión
+ * @param wb Constructor de la palabra
+ * @param quoted Indica si está dentro de comillas dobles
+ * @return 1 si es correcta, 0 si está incompleta, -1 si hay error
+ */
+static int lex_dollar(const char **pp, WordBuilder *wb, int quoted) {
+    const char *p = *pp + 1;
+
+    if (*p == '?' || *p == '$') {
+        wb_expansion(wb, *p == '?' ? SEG_STATUS : SEG_PID, quoted, p, 1, NULL);
+        *pp = p + 1;
+        return 1;
+    }
+
+    if (*p == '#' || *p == '@' || *p == '*' || isdigit((unsigned char)*p)) {
+        SegmentType type = *p == '#' ? SEG_NPARAMS : isdigit((unsigned char)*p) ? SEG_PARAM : SEG_ALLPARAMS;
+        wb_expansion(wb, type, quoted, p, 1, NULL);
+        *pp = p + 1;
+        return 1;
+    }
+
+    if (*p == '(') {
+        if (p[1] == '(')
+            return lex_arith(pp, wb, quoted);
+
+        const char *q = p + 1;
+        Program *prog;
+        int result = vm_compile_subst(&q, &prog);
+        if (result != 1)
+            return result;
+        wb_expansion(wb, SEG_SUBST, quoted, p + 1, q - p - 2, prog);
+        *pp = q;
+        return 1;
+    }
+
+    if (*p == '{') {
+        const char *end = strchr(p, '}');
+        if (end == NULL)
+            return 0;
+
+        size_t len = end - p - 1;
+        int digits = len > 0 && strspn(p + 1, "0123456789") == len;
+        if (len == 1 && p[1] == '?') {
+            wb_expansion(wb, SEG_STATUS, quoted, p + 1, 1, NULL);
+        } else if (len == 1 && p[1] == '#') {
+            wb_expansion(wb, SEG_NPARAMS, quoted, p + 1, 1, NULL);
+        } else if (digits) {
+            wb_expansion(wb, SEG_PARAM, quoted, p + 1, len, NULL);
+        } else if (is_valid_var_name(p + 1, len)) {
+            wb_expansion(wb, SEG_VAR, quoted, p + 1, len, NULL);
+        } else {
+            fprintf(stderr, "dwimsh: %.*s: sustitución incorrecta\n", (int)(end - *pp + 1), *pp);
+            return -1;
+        }
+        *pp = end + 1;
+        return 1;
+    }
+
+    if (isalpha((unsigned char)*p) || *p == '_') {
+        const char *start = p;
+        while (isalnum((unsigned char)*p) || *p == '_')
+            p++;
+        wb_expansion(wb, SEG_VAR, quoted, start, p - start, NULL);
+        *pp = p;
+        return 1;
+    }
+
+    // Un $ que no inicia una expansión es literal
+    wb_char(wb, '$', quoted);
+    *pp = p;
+    return 1;
+}
+
+/**
+ * @brief Verifica si una palabra recién analizada es una asignación
+ * @param word Palabra a verificar
+ * @return 1 si es de la forma NOMBRE=valor, 0 si no
+ */
+static int word_is_assignment(const WordPlan *word) {
+    if (word->nsegs == 0 || word->segs[0].type != SEG_LITERAL || word->segs[0].quoted)
+        return 0;
+    const char *eq = strchr(word->segs[0].text, '=');
+    return eq != NULL && is_valid_var_name(word->segs[0].text, eq - word->segs[0].text);
+}
+
+/**
+ * @brief Analiza una palabra de la línea
+ * @param pp Posición actual (al inicio de la palabra), se avanza tras ella
+ * @param word Plan de la palabra (se inicializa aquí)
+ * @return 1 si es correcta, 0 si está incompleta, -1 si hay error
+ *
+ * La palabra termina en un espacio o en uno de los operadores ; & | ( ).
+ */
+int lex_word(const char **pp, WordPlan *word) {
+    const char *p = *pp;
+    const char *start = p;
+    WordBuilder wb = {word, 0, {NULL, 0, 0}, 0, 0};
+    int result = 1;
+
+    memset(word, 0, sizeof(*word));
+
+    while (*p != '\0' && !isspace((unsigned char)*p) && strchr(WORD_OPERATORS, *p) == NULL && result == 1) {
+        if (*p == '\\') {
+            if (p[1] == '\0') {
+                result = 0;
+            } else if (p[1] == '\n') {
+                p += 2;
+            } else {
+                wb_char(&wb, p[1], 1);
+                p += 2;
+            }
+        } else if (*p == '\'') {
+            const char *end = strchr(p + 1, '\'');
+            if (end == NULL) {
+                result = 0;
+                break;
+            }
+            wb_open_quoted(&wb);
+            for (p++; p < end; p++)
+                wb_char(&wb, *p, 1);
+            p++;
+        } else if (*p == '"') {
+            wb_open_quoted(&wb);
+            for (p++; *p != '"' && *p != '\0' && result == 1; ) {
+                if (*p == '\\' && p[1] != '\0' && strchr("$`\"\\\n", p[1]) != NULL) {
+                    if (p[1] != '\n')
+                        wb_char(&wb, p[1], 1);
+                    p += 2;
+                } else if (*p == '$') {
+                    result = lex_dollar(&p, &wb, 1);
+                } else {
+                    wb_char(&wb, *p++, 1);
+                }
+            }
+            if (*p != '"') {
+                if (result == 1)
+                    result = 0;
+                break;
+            }
+            p++;
+        } else if (*p == '$') {
+            result = lex_dollar(&p, &wb, 0);
+        } else if (*p == '~' && p == start) {
+            const char *q = p + 1;
+            while (*q != '\0' && *q != '/' && !isspace((unsigned char)*q) &&
+                   strchr("'\"\\$" WORD_OPERATORS, *q) == NULL)
+                q++;
+            if (*q != '\0' && strchr("'\"\\$", *q) != NULL) {
+                wb_char(&wb, *p++, 0);
+            } else {
+                wb_expansion(&wb, SEG_TILDE, 0, p + 1, q - p - 1, NULL);
+                p = q;
+            }
+        } else {
+            wb_char(&wb, *p++, 0);
+        }
+    }
+
+    wb_flush(&wb);
+    free(wb.lit.data);
+    *pp = p;
+    return result;
+}
+
+/**
+ * @brief Verifica si los literales sin comillas de una palabra forman un patrón glob
+ * @param word Palabra a verificar
+ * @return 1 si contiene * o ?, o un [ con su ] de cierre; 0 si no
+ *
+ * Un [ sin cierre (como el comando "[") no puede coincidir con nada, así
+ * que la palabra se trata como literal y no se lee ningún directorio.
+ */
+static int word_has_pattern(const WordPlan *word) {
+    int open = 0;
+    for (int i = 0; i < word->nsegs; i++) {
+        const Segment *seg = &word->segs[i];
+        if (seg->type != SEG_LITERAL || seg->quoted)
+            continue;
+        for (size_t j = 0; j < seg->len; j++) {
+            if (seg->text[j] == '*' || seg->text[j] == '?' || (open && seg->text[j] == ']'))
+                return 1;
+            if (seg->text[j] == '[')
+                open = 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Completa el análisis de una palabra
+ * @param word Palabra analizada con lex_word
+ * @param assign_ok Indica si la palabra puede ser una asignación
+ *
+ * Las asignaciones no se dividen en campos ni se expanden como glob.
+ * Si la palabra no tiene expansiones, su valor final se calcula aquí
+ * para que la ejecución solo tenga que copiarlo.
+ */
+void word_finalize(WordPlan *word, int assign_ok) {
+    if (assign_ok && word_is_assignment(word))
+        word->flags = (word->flags | WORD_ASSIGN) & ~(WORD_GLOB | WORD_SPLIT);
+    if ((word->flags & WORD_GLOB) && !word_has_pattern(word))
+        word->flags &= ~WORD_GLOB;
+
+    int is_static = !(word->flags & WORD_GLOB);
+    for (int i = 0; i < word->nsegs && is_static; i++) {
+        if (word->segs[i].type != SEG_LITERAL)
+            is_static = 0;
+    }
+    if (is_static) {
+        Buf text = {NULL, 0, 0};
+        buf_append(&text, "", 0);
+        for (int i = 0; i < word->nsegs; i++)
+            buf_append(&text, word->segs[i].text, word->segs[i].len);
+        word->text = text.data;
+        word->flags |= WORD_STATIC;
+    }
+}
+
+/**
+ * @brief Indica si una palabra es la palabra reservada indicada
+ * @param word Palabra analizada
+ * @param keyword Palabra reservada (por ejemplo "if")
+ * @return 1 si la palabra es exactamente keyword sin comillas, 0 si no
+ */
+int word_is_keyword(const WordPlan *word, const char *keyword) {
+    return word->nsegs == 1 && word->segs[0].type == SEG_LITERAL &&
+           !word->segs[0].quoted && strcmp(word->segs[0].text, keyword) == 0;
+}
+
+/**
+ * @brief Libera los segmentos de una palabra
+ * @param word Palabra a liberar
+ */
+void word_free(WordPlan *word) {
+    for (int i = 0; i < word->nsegs; i++) {
+        if (word->segs[i].type == SEG_ARITH) {
+            arith_free(word->segs[i].data);
+        } else if (word->segs[i].type == SEG_ARITH_EXPAND) {
+            word_free(word->segs[i].data);
+            free(word->segs[i].data);
+        } else if (word->segs[i].type == SEG_SUBST) {
+            program_release(word->segs[i].data);
+        }
+        free(word->segs[i].text);
+    }
+    free(word->segs);
+    free(word->text);
+}
+
+/**
+ * @brief Libera un plan de expansión
+ * @param plan Plan a liberar
+ */
+void plan_free(CommandPlan *plan) {
+    if (plan == NULL)
+        return;
+    for (int i = 0; i < plan->nwords; i++)
+        word_free(&plan->words[i]);
+    free(plan->words);
+    free(plan);
+}
+
+/**
+ * @brief Campo en construcción durante la expansión de una palabra
+ */
+typedef struct {
+    Buf value;
+    Buf pattern;
+    int has_field;
+    int glob;
+} Field;
+
+/**
+ * @brief Añade texto a un campo
+ * @param f Campo en construcción
+ * @param s Texto a añadir
+ * @param len Longitud del texto
+ * @param word_glob Indica si la palabra puede expandirse como glob
+ * @param raw Indica si los metacaracteres del texto son activos (literal sin comillas)
+ */
+static void field_add(Field *f, const char *s, size_t len, int word_glob, int raw) {
+    buf_append(&f->value, s, len);
+    f->has_field = 1;
+    if (!word_glob)
+        return;
+
+    for (size_t i = 0; i < len; i++) {
+        if (raw && strchr("*?[", s[i]) != NULL)
+            f->glob = 1;
+        else if (!raw && strchr("*?[]\\", s[i]) != NULL)
+            buf_putc(&f->pattern, '\\');
+        buf_putc(&f->pattern, s[i]);
+    }
+}
+
+/**
+ * @brief Termina un campo y lo añade a la lista (expandiendo glob si aplica)
+ * @param f Campo en construcción
+ * @param out Lista de argumentos
+ *
+ * Si el patrón no coincide con ningún archivo, se conserva el texto tal cual.
+ */
+static void field_finish(Field *f, ArgList *out) {
+    if (!f->glob || glob_expand(f->pattern.data, out) == 0)
+        arglist_push(out, strdup(f->value.data ? f->value.data : ""));
+    buf_reset(&f->value);
+    buf_reset(&f->pattern);
+    f->has_field = 0;
+    f->glob = 0;
+}
+
+/**
+ * @brief Obtiene el directorio home de un usuario para la expansión de ~
+ * @param user Nombre del usuario (vacío para el usuario actual)
+ * @return Directorio home o NULL si el usuario no existe
+ */
+static const char *tilde_home(const char *user) {
+    if (user[0] == '\0') {
+        const char *home = var_get("HOME");
+        if (home != NULL)
+            return home;
+        struct passwd *pw = getpwuid(getuid());
+        return pw ? pw->pw_dir : NULL;
+    }
+    struct passwd *pw = getpwnam(user);
+    return pw ? pw->pw_dir : NULL;
+}
+
+/**
+ * @brief Expande una palabra y añade los campos resultantes a la lista
+ * @param word Plan de la palabra
+ * @param out Lista donde se añaden los campos
+ *
+ * Las expansiones sin comillas se dividen en campos por espacios,
+ * tabuladores y saltos de línea, y sus metacaracteres glob son activos.
+ * "$@" produce un campo por cada parámetro posicional.
+ */
+void expand_word(const WordPlan *word, ArgList *out) {
+    if (word->flags & WORD_STATIC) {
+        arglist_push(out, strdup(word->text));
+        return;
+    }
+
+    // Los valores sin comillas también pueden producir patrones glob
+    int glob = (word->flags & (WORD_GLOB | WORD_SPLIT)) != 0;
+    Field f = {{NULL, 0, 0}, {NULL, 0, 0}, 0, 0};
+    Buf joined = {NULL, 0, 0};
+    char number[32];
+
+    for (int i = 0; i < word->nsegs; i++) {
+        const Segment *seg = &word->segs[i];
+        const char *value = NULL;
+        char *owned = NULL;
+        int error;
+
+        switch (seg->type) {
+            case SEG_LITERAL:
+                field_add(&f, seg->text, seg->len, glob, !seg->quoted);
+                continue;
+            case SEG_TILDE:
+                value = tilde_home(seg->text);
+                if (value == NULL) {
+                    field_add(&f, "~", 1, glob, 0);
+                    value = seg->text;
+                }
+                field_add(&f, value, strlen(value), glob, 0);
+                continue;
+            case SEG_STATUS:
+                snprintf(number, sizeof(number), "%d", last_command_status);
+                value = number;
+                break;
+            case SEG_PID:
+                snprintf(number, sizeof(number), "%d", (int)getpid());
+                value = number;
+                break;
+            case SEG_VAR:
+                value = var_get_n(seg->text, seg->len, seg->hash);
+                if (value == NULL)
+                    value = "";
+                break;
+            case SEG_PARAM: {
+                int index = atoi(seg->text);
+                value = index < positional_params.argc ? positional_params.argv[index] : "";
+                break;
+            }
+            case SEG_NPARAMS:
+                snprintf(number, sizeof(number), "%d", positional_params.argc > 0 ? positional_params.argc - 1 : 0);
+                value = number;
+                break;
+            case SEG_ALLPARAMS:
+                if (seg->quoted && seg->text[0] == '@') {
+                    for (int j = 1; j < positional_params.argc; j++) {
+                        if (j > 1)
+                            field_finish(&f, out);
+                        field_add(&f, positional_params.argv[j], strlen(positional_params.argv[j]), glob, 0);
+                    }
+                    continue;
+                }
+                buf_reset(&joined);
+                buf_append(&joined, "", 0);
+                for (int j = 1; j < positional_params.argc; j++) {
+                    if (j > 1)
+                        buf_putc(&joined, ' ');
+                    buf_append(&joined, positional_params.argv[j], strlen(positional_params.argv[j]));
+                }
+                value = joined.data;
+                break;
+            case SEG_ARITH:
+                snprintf(number, sizeof(number), "%lld", arith_eval(seg->data, &error));
+                if (error)
+                    expand_failed = 1;
+                value = number;
+                break;
+            case SEG_ARITH_EXPAND: {
+                ArgList text = {NULL, 0, 0};
+                ArithExpr *expr;
+                expand_word(seg->data, &text);
+                expr = text.argc > 0 ? arith_compile(text.argv[0], strlen(text.argv[0])) : NULL;
+                if (expr == NULL) {
+                    expand_failed = 1;
+                    number[0] = '\0';
+                } else {
+                    snprintf(number, sizeof(number), "%lld", arith_eval(expr, &error));
+                    if (error)
+                        expand_failed = 1;
+                    arith_free(expr);
+                }
+                arglist_free(&text);
+                value = number;
+                break;
+            }
+            case SEG_SUBST:
+                owned = vm_capture(seg->data);
+                value = owned;
+                break;
+        }
+
+        if (seg->quoted || !(word->flags & WORD_SPLIT)) {
+            field_add(&f, value, strlen(value), glob, 0);
+        } else {
+            // División en campos de una expansión sin comillas
+            for (const char *v = value; *v != '\0'; ) {
+                size_t run = strcspn(v, " \t\n");
+                if (run > 0) {
+                    field_add(&f, v, run, glob, 1);
+                    v += run;
+                }
+                if (*v != '\0') {
+                    if (f.has_field)
+                        field_finish(&f, out);
+                    v++;
+                }
+            }
+        }
+        free(owned);
+    }
+
+    if (f.has_field)
+        field_finish(&f, out);
+
+    free(f.value.data);
+    free(f.pattern.data);
+    free(joined.data);
+}
+
+/**
+ * @brief Expande todas las palabras de un plan
+ * @param plan Plan de la línea
+ * @param out Lista donde se añaden los argumentos
+ */
+void plan_expand(const CommandPlan *plan, ArgList *out) {
+    for (int i = 0; i < plan->nwords; i++)
+        expand_word(&plan->words[i], out);
+}
+
+/**
+ * @brief Verifica si un componente de ruta contiene metacaracteres sin escapar
+ * @param s Componente a verificar
+ * @return 1 si contiene *, ? o [, 0 si no
+ */
+static int has_glob_meta(const char *s) {
+    for (; *s != '\0'; s++) {
+        if (*s == '\\' && s[1] != '\0')
+            s++;
+        else if (*s == '*' || *s == '?' || *s == '[')
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Compara dos cadenas para qsort
+ * @param a Puntero a la primera cadena
+ * @param b Puntero a la segunda cadena
+ * @return Resultado de strcmp
+ */
+static int compare_strings(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static void glob_walk(Buf *path, char **comps, int ncomps, ArgList *out);
+
+/**
+ * @brief Procesa una entrada de directorio durante la expansión glob
+ * @param path Ruta del directorio (se restaura al terminar)
+ * @param comps Componentes pendientes (comps[0] es el patrón actual)
+ * @param ncomps Número de componentes pendientes
+ * @param name Nombre de la entrada
+ * @param type Tipo de la entrada (DT_*)
+ * @param out Lista de coincidencias
+ */
+static void glob_entry(Buf *path, char **comps, int ncomps, const char *name,
+                       unsigned char type, ArgList *out) {
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+        return;
+    if (fnmatch(comps[0], name, FNM_PERIOD) != 0)
+        return;
+
+    size_t saved = path->len;
+    buf_append(path, name, strlen(name));
+
+    if (ncomps == 1) {
+        arglist_push(out, strdup(path->data));
+    } else {
+        struct stat st;
+        int is_dir = type == DT_DIR;
+        if (type == DT_LNK || type == DT_UNKNOWN)
+            is_dir = stat(path->data, &st) == 0 && S_ISDIR(st.st_mode);
+        if (is_dir) {
+            buf_putc(path, '/');
+            glob_walk(path, comps + 1, ncomps - 1, out);
+        }
+    }
+
+    path->len = saved;
+    path->data[saved] = '\0';
+}
+
+#ifdef SYS_getdents64
+/**
+ * @brief Formato de las entradas devueltas por getdents64
+ */
+struct dirent64_raw {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+/**
+ * @brief Recorre recursivamente los componentes de un patrón glob
+ * @param path Ruta construida hasta ahora (termina en '/' o está vacía)
+ * @param comps Componentes pendientes del patrón
+ * @param ncomps Número de componentes pendientes
+ * @param out Lista de coincidencias
+ *
+ * Los componentes sin metacaracteres se añaden directamente a la ruta.
+ * Para los demás, el directorio se lee una sola vez con getdents64 en
+ * bloques grandes y cada entrada se compara con fnmatch.
+ */
+static void glob_walk(Buf *path, char **comps, int ncomps, ArgList *out) {
+    size_t saved = path->len;
+
+    if (!has_glob_meta(comps[0])) {
+        for (const char *c = comps[0]; *c != '\0'; c++) {
+            if (*c == '\\' && c[1] != '\0')
+                c++;
+            buf_putc(path, *c);
+        }
+        if (path->data == NULL)
+            buf_append(path, "", 0);
+
+        struct stat st;
+        if (ncomps == 1) {
+            if (lstat(path->data, &st) == 0)
+                arglist_push(out, strdup(path->data));
+        } else {
+            buf_putc(path, '/');
+            glob_walk(path, comps + 1, ncomps - 1, out);
+        }
+        path->len = saved;
+        path->data[saved] = '\0';
+        return;
+    }
+
+    const char *dir = path->len > 0 ? path->data : ".";
+
+#ifdef SYS_getdents64
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    char *buf = malloc(GLOB_DIRENT_BUF);
+    long nread;
+    while (buf != NULL && (nread = syscall(SYS_getdents64, fd, buf, GLOB_DIRENT_BUF)) > 0) {
+        for (long offset = 0; offset < nread; ) {
+            struct dirent64_raw *entry = (struct dirent64_raw *)(buf + offset);
+            offset += entry->d_reclen;
+            glob_entry(path, comps, ncomps, entry->d_name, entry->d_type, out);
+        }
+    }
+    free(buf);
+    close(fd);
+#else
+    DIR *d = opendir(dir);
+    if (d == NULL)
+        return;
+
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL)
+        glob_entry(path, comps, ncomps, entry->d_name, entry->d_type, out);
+    closedir(d);
+#endif
+}
+
+/**
+ * @brief Expande un patrón glob y añade las coincidencias ordenadas
+ * @param pattern Patrón (los metacaracteres escapados con \ son literales)
+ * @param out Lista donde se añaden las coincidencias
+ * @return Número de coincidencias encontradas
+ *
+ * Los archivos que empiezan con punto solo coinciden si el patrón
+ * también empieza con punto.
+ */
+int glob_expand(const char *pattern, ArgList *out) {
+    int start = out->argc;
+    char *copy = strdup(pattern);
+    char **comps = malloc((strlen(pattern) + 2) * sizeof(char *));
+    int ncomps = 0;
+    Buf path = {NULL, 0, 0};
+    char *p = copy;
+
+    buf_append(&path, "", 0);
+    if (*p == '/') {
+        buf_putc(&path, '/');
+        p++;
+    }
+
+    // Separar en componentes por '/', conservando los vacíos
+    comps[ncomps++] = p;
+    for (; *p != '\0'; p++) {
+        if (*p == '\\' && p[1] != '\0') {
+            p++;
+        } else if (*p == '/') {
+            *p = '\0';
+            comps[ncomps++] = p + 1;
+        }
+    }
+
+    if (ncomps > 0 && comps[ncomps - 1][0] == '\0' && ncomps > 1) {
+        // Un patrón que termina en '/' solo coincide con directorios
+        ncomps--;
+        ArgList dirs = {NULL, 0, 0};
+        glob_walk(&path, comps, ncomps, &dirs);
+        for (int i = 0; i < dirs.argc; i++) {
+            struct stat st;
+            if (stat(dirs.argv[i], &st) == 0 && S_ISDIR(st.st_mode)) {
+                size_t len = strlen(dirs.argv[i]);
+                char *dir = malloc(len + 2);
+                memcpy(dir, dirs.argv[i], len);
+                strcpy(dir + len, "/");
+                arglist_push(out, dir);
+            }
+        }
+        arglist_free(&dirs);
+    } else {
+        glob_walk(&path, comps, ncomps, out);
+    }
+
+    qsort(out->argv + start, out->argc - start, sizeof(char *), compare_strings);
+
+    free(path.data);
+    free(comps);
+    free(copy);
+    return out->argc - start;
+}
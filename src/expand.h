@@ -0,0 +1,181 @@
+/**
+ * @file expand.h
+ * @brief Definición del análisis y la expansión de líneas de comando
+ *
+ * Este archivo define el plan de expansión precompilado de un comando:
+ * cada palabra se divide en segmentos (texto literal, variables, $?, ~,
+ * $((...)), $(...)) durante el análisis, de modo que al ejecutar el
+ * comando solo se evalúan los segmentos sin volver a leer el texto.
+ */
+
+#ifndef EXPAND_H
+#define EXPAND_H
+
+#include "shell.h"
+
+/**
+ * @brief Tipos de segmento de una palabra
+ */
+typedef enum {
+    SEG_LITERAL, /**< Texto literal */
+    SEG_VAR,     /**< $NOMBRE o ${NOMBRE} */
+    SEG_STATUS,  /**< $? */
+    SEG_PID,     /**< $$ */
+    SEG_TILDE,   /**< ~ o ~usuario al inicio de la palabra */
+    SEG_PARAM,   /**< $0 a $9 o ${N}: parámetro posicional */
+    SEG_NPARAMS, /**< $#: número de parámetros posicionales */
+    SEG_ALLPARAMS, /**< $@ o $*: todos los parámetros posicionales */
+    SEG_ARITH,   /**< $((expresión)) ya compilada */
+    SEG_ARITH_EXPAND, /**< $((expresión)) con $1, $(...), etc. que se expanden antes de evaluarla */
+    SEG_SUBST    /**< $(comandos) ya compilados */
+} SegmentType;
+
+/**
+ * @brief Segmento de una palabra ya analizada
+ */
+typedef struct {
+    /** Tipo de segmento */
+    SegmentType type;
+    /** Indica si el segmento estaba entre comillas */
+    int quoted;
+    /** Texto literal, nombre de la variable o usuario de ~ */
+    char *text;
+    /** Longitud de text */
+    size_t len;
+    /** Hash del nombre de la variable (solo SEG_VAR) */
+    unsigned int hash;
+    /** Expresión (SEG_ARITH), palabra interior (SEG_ARITH_EXPAND) o programa (SEG_SUBST) */
+    void *data;
+} Segment;
+
+// Indicadores de una palabra
+#define WORD_STATIC  0x01 /**< Sin expansiones: el valor está en text */
+#define WORD_GLOB    0x02 /**< Contiene *, ? o [ sin comillas */
+#define WORD_SPLIT   0x04 /**< Contiene expansiones sin comillas */
+#define WORD_ASSIGN  0x08 /**< Es una asignación NOMBRE=valor */
+
+/**
+ * @brief Plan de expansión de una palabra
+ */
+typedef struct {
+    /** Segmentos que forman la palabra */
+    Segment *segs;
+    /** Número de segmentos */
+    int nsegs;
+    /** Combinación de indicadores WORD_* */
+    int flags;
+    /** Valor final si la palabra es WORD_STATIC */
+    char *text;
+} WordPlan;
+
+/**
+ * @brief Plan de expansión de un comando simple
+ */
+typedef struct CommandPlan {
+    /** Palabras de la línea */
+    WordPlan *words;
+    /** Número de palabras */
+    int nwords;
+    /** Indica si el comando termina en & */
+    int background;
+    /** Índice del built-in si el nombre del comando es fijo, -1 si no */
+    int builtin;
+} CommandPlan;
+
+/**
+ * @brief Lista dinámica de argumentos terminada en NULL
+ */
+typedef struct {
+    /** Argumentos (cada uno reservado con malloc) */
+    char **argv;
+    /** Número de argumentos */
+    int argc;
+    /** Capacidad reservada */
+    int cap;
+} ArgList;
+
+/**
+ * @brief Añade un argumento a la lista (la lista toma posesión de él)
+ * @param list Lista de argumentos
+ * @param arg Argumento reservado con malloc
+ */
+void arglist_push(ArgList *list, char *arg);
+
+/**
+ * @brief Libera los argumentos de la lista
+ * @param list Lista de argumentos
+ */
+void arglist_free(ArgList *list);
+
+/**
+ * @brief Indica si ocurrió un error durante la última expansión
+ *
+ * Se pone a 1 cuando falla una expansión aritmética; quien ejecuta el
+ * comando debe comprobarlo y no ejecutarlo.
+ */
+extern int expand_failed;
+
+/**
+ * @brief Analiza una palabra de la línea
+ * @param pp Posición actual (al inicio de la palabra), se avanza tras ella
+ * @param word Plan de la palabra (se inicializa aquí)
+ * @return 1 si es correcta, 0 si está incompleta, -1 si hay error
+ *
+ * La palabra termina en un espacio o en uno de los operadores ; & | ( ).
+ */
+int lex_word(const char **pp, WordPlan *word);
+
+/**
+ * @brief Completa el análisis de una palabra
+ * @param word Palabra analizada con lex_word
+ * @param assign_ok Indica si la palabra puede ser una asignación
+ *
+ * Las asignaciones no se dividen en campos ni se expanden como glob.
+ * Si la palabra no tiene expansiones, su valor final se calcula aquí
+ * para que la ejecución solo tenga que copiarlo.
+ */
+void word_finalize(WordPlan *word, int assign_ok);
+
+/**
+ * @brief Indica si una palabra es la palabra reservada indicada
+ * @param word Palabra analizada
+ * @param keyword Palabra reservada (por ejemplo "if")
+ * @return 1 si la palabra es exactamente keyword sin comillas, 0 si no
+ */
+int word_is_keyword(const WordPlan *word, const char *keyword);
+
+/**
+ * @brief Libera los segmentos de una palabra
+ * @param word Palabra a liberar
+ */
+void word_free(WordPlan *word);
+
+/**
+ * @brief Libera un plan de expansión
+ * @param plan Plan a liberar
+ */
+void plan_free(CommandPlan *plan);
+
+/**
+ * @brief Expande una palabra y añade los campos resultantes a la lista
+ * @param word Plan de la palabra
+ * @param out Lista donde se añaden los campos
+ */
+void expand_word(const WordPlan *word, ArgList *out);
+
+/**
+ * @brief Expande todas las palabras de un plan
+ * @param plan Plan de la línea
+ * @param out Lista donde se añaden los argumentos
+ */
+void plan_expand(const CommandPlan *plan, ArgList *out);
+
+/**
+ * @brief Expande un patrón glob y añade las coincidencias ordenadas
+ * @param pattern Patrón (los metacaracteres escapados con \ son literales)
+ * @param out Lista donde se añaden las coincidencias
+ * @return Número de coincidencias encontradas
+ */
+int glob_expand(const char *pattern, ArgList *out);
+
+#endif // EXPAND_H
@@ -0,0 +1,505 @@
+/**
+ * @file jobs.c
+ * @brief Implementación de la captura de salida de los procesos en segundo plano
+ *
+ * Un único lector vacía las tuberías de todos los trabajos: con epoll en
+ * Linux y con poll en otros sistemas. Mientras readline espera una tecla
+ * también se espera por la salida de los trabajos, así que las tuberías
+ * se vacían sin bloquear el prompt y sin escribir sobre él.
+ *
+ * El búfer circular de cada trabajo solo lo escribe ese lector y solo lo
+ * leen los built-ins del mismo hilo, por lo que no necesita bloqueos:
+ * head y tail son posiciones absolutas que solo crecen y la posición en
+ * el búfer se obtiene con una máscara. Cuando el búfer está lleno, su
+ * parte más antigua se escribe en un archivo temporal ya borrado del
+ * directorio (el "spill"), que guarda el principio de la salida hasta
+ * JOB_SPILL_MAX bytes.
+ */
+
+#include "jobs.h"
+#include "vm.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+// Tamaño del búfer circular de cada trabajo (potencia de 2)
+#define JOB_RING_SIZE (1024 * 1024)
+
+// Bytes que se pasan al archivo temporal cada vez que el búfer se llena
+#define JOB_SPILL_CHUNK (256 * 1024)
+
+// Tamaño máximo del archivo temporal de cada trabajo
+#define JOB_SPILL_MAX (256 * 1024 * 1024)
+
+// Bytes máximos leídos de un trabajo por cada aviso, para repartir el tiempo entre trabajos y teclado
+#define JOB_READ_BUDGET (4 * 1024 * 1024)
+
+// Tamaño solicitado para las tuberías de los trabajos (menos llamadas a read)
+#define JOB_PIPE_SIZE (1024 * 1024)
+
+// Trabajos terminados que se conservan para poder consultar su salida
+#define JOBS_KEEP_FINISHED 32
+
+// Líneas que muestra jobstream antes de seguir la salida
+#define JOB_STREAM_LINES 10
+
+static Job **jobs = NULL;
+static int job_count = 0;
+static int job_capacity = 0;
+static int next_job_id = 1;
+
+// Trabajos cuya tubería sigue abierta
+static int open_pipes = 0;
+
+#ifdef __linux__
+static int epoll_fd = -1;
+#endif
+
+/**
+ * @brief Escribe un bloque completo en un descriptor
+ * @param fd Descriptor de destino
+ * @param data Datos
+ * @param len Número de bytes
+ * @return 0 si se escribió todo, -1 si hubo un error
+ */
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Pasa la parte más antigua del búfer al archivo temporal
+ * @param job Trabajo con el búfer lleno
+ *
+ * El archivo guarda el principio de la salida hasta JOB_SPILL_MAX bytes;
+ * a partir de ahí (o si no se puede crear) los bytes más antiguos del
+ * búfer se descartan.
+ */
+static void job_spill(Job *job) {
+    size_t offset = job->tail & (job->ring_size - 1);
+    size_t len = job->ring_size - offset;
+    if (len > JOB_SPILL_CHUNK)
+        len = JOB_SPILL_CHUNK;
+
+    if (job->spill_fd == -1) {
+        const char *dir = getenv("TMPDIR");
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/dwimsh-job-XXXXXX", dir && *dir ? dir : "/tmp");
+        job->spill_fd = mkstemp(path);
+        if (job->spill_fd >= 0) {
+            unlink(path);
+            fcntl(job->spill_fd, F_SETFD, FD_CLOEXEC);
+        } else {
+            job->spill_fd = -2;
+        }
+    }
+    if (job->spill_fd >= 0 && job->spilled == job->tail && job->spilled + len <= JOB_SPILL_MAX) {
+        if (write_all(job->spill_fd, job->ring + offset, len) == 0)
+            job->spilled += len;
+    }
+    job->tail += len;
+}
+
+/**
+ * @brief Deja de vigilar la tubería de un trabajo
+ * @param job Trabajo cuya tubería llegó al final
+ */
+static void job_close_pipe(Job *job) {
+#ifdef __linux__
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, job->fd, NULL);
+#endif
+    close(job->fd);
+    job->fd = -1;
+    open_pipes--;
+}
+
+/**
+ * @brief Copia al búfer la salida disponible de un trabajo
+ * @param job Trabajo con datos pendientes
+ *
+ * Se lee directamente sobre el hueco libre del búfer, sin copias
+ * intermedias. Se lee como máximo JOB_READ_BUDGET bytes por llamada.
+ */
+static void job_read(Job *job) {
+    size_t budget = JOB_READ_BUDGET;
+
+    while (job->fd >= 0 && budget > 0) {
+        if (job->head - job->tail == job->ring_size)
+            job_spill(job);
+
+        size_t offset = job->head & (job->ring_size - 1);
+        size_t room = job->ring_size - (job->head - job->tail);
+        size_t len = job->ring_size - offset;
+        if (len > room)
+            len = room;
+
+        ssize_t n = read(job->fd, job->ring + offset, len);
+        if (n > 0) {
+            job->head += n;
+            budget = (size_t)n < budget ? budget - n : 0;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && errno == EAGAIN) {
+            break;
+        } else {
+            job_close_pipe(job);
+        }
+    }
+}
+
+/**
+ * @brief Espera salida de los trabajos o datos en un descriptor adicional
+ * @param extra_fd Descriptor adicional (por ejemplo el teclado) o -1
+ * @param timeout Milisegundos máximos de espera (-1 sin límite)
+ * @return 1 si extra_fd tiene datos, 0 si no, -1 si la espera fue interrumpida
+ */
+static int jobs_wait(int extra_fd, int timeout) {
+#ifdef __linux__
+    struct epoll_event events[64];
+    int ready;
+
+    if (extra_fd >= 0) {
+        struct pollfd fds[2] = {{extra_fd, POLLIN, 0}, {epoll_fd, POLLIN, 0}};
+        if (poll(fds, 2, timeout) < 0)
+            return errno == EINTR ? -1 : 1;
+        if (fds[1].revents & POLLIN) {
+            ready = epoll_wait(epoll_fd, events, 64, 0);
+            for (int i = 0; i < ready; i++)
+                job_read(events[i].data.ptr);
+        }
+        return (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+    }
+
+    ready = epoll_wait(epoll_fd, events, 64, timeout);
+    if (ready < 0)
+        return errno == EINTR ? -1 : 0;
+    for (int i = 0; i < ready; i++)
+        job_read(events[i].data.ptr);
+    return 0;
+#else
+    struct pollfd *fds = malloc((job_count + 1) * sizeof(struct pollfd));
+    Job **owners = malloc((job_count + 1) * sizeof(Job *));
+    int nfds = 0;
+    int result = 0;
+
+    if (extra_fd >= 0) {
+        fds[nfds].fd = extra_fd;
+        fds[nfds].events = POLLIN;
+        owners[nfds++] = NULL;
+    }
+    for (int i = 0; i < job_count; i++) {
+        if (jobs[i]->fd >= 0) {
+            fds[nfds].fd = jobs[i]->fd;
+            fds[nfds].events = POLLIN;
+            owners[nfds++] = jobs[i];
+        }
+    }
+
+    if (poll(fds, nfds, timeout) < 0) {
+        result = errno == EINTR ? -1 : extra_fd >= 0;
+    } else {
+        for (int i = 0; i < nfds; i++) {
+            if (owners[i] == NULL)
+                result = (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+            else if (fds[i].revents)
+                job_read(owners[i]);
+        }
+    }
+    free(fds);
+    free(owners);
+    return result;
+#endif
+}
+
+/**
+ * @brief Espera una tecla para readline vaciando mientras tanto las tuberías
+ * @param stream Entrada de readline
+ * @return Carácter leído (lo que devuelva rl_getc)
+ */
+static int jobs_getc(FILE *stream) {
+    while (open_pipes > 0) {
+        int result = jobs_wait(fileno(stream), -1);
+        if (result == 1)
+            break;
+        // Dejar que readline atienda Ctrl+C (redibuja el prompt)
+        if (result < 0)
+            rl_check_signals();
+    }
+    return rl_getc(stream);
+}
+
+/**
+ * @brief Prepara la captura de trabajos e integra su lectura con readline
+ */
+void jobs_init(void) {
+#ifdef __linux__
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+        perror("epoll_create1");
+#endif
+    rl_getc_function = jobs_getc;
+}
+
+/**
+ * @brief Libera un trabajo terminado
+ * @param index Posición del trabajo en la tabla
+ */
+static void job_free(int index) {
+    Job *job = jobs[index];
+    if (job->fd >= 0)
+        job_close_pipe(job);
+    if (job->spill_fd >= 0)
+        close(job->spill_fd);
+    free(job->ring);
+    free(job->command);
+    free(job);
+    memmove(jobs + index, jobs + index + 1, (job_count - index - 1) * sizeof(Job *));
+    job_count--;
+}
+
+/**
+ * @brief Registra un trabajo recién lanzado
+ * @param pid PID del proceso hijo
+ * @param fd Extremo de lectura de la tubería conectada a su stdout y stderr
+ * @param argv Argumentos del comando
+ * @return Trabajo registrado
+ *
+ * Si hay demasiados trabajos terminados se descarta el más antiguo.
+ */
+Job *job_start(pid_t pid, int fd, char **argv) {
+    int finished = 0;
+    for (int i = 0; i < job_count; i++)
+        finished += !jobs[i]->running && jobs[i]->fd < 0;
+    for (int i = 0; i < job_count && finished >= JOBS_KEEP_FINISHED; ) {
+        if (!jobs[i]->running && jobs[i]->fd < 0 && jobs[i]->notified) {
+            job_free(i);
+            finished--;
+        } else {
+            i++;
+        }
+    }
+
+    if (job_count == job_capacity) {
+        job_capacity = job_capacity ? job_capacity * 2 : 8;
+        jobs = realloc(jobs, job_capacity * sizeof(Job *));
+    }
+
+    Job *job = calloc(1, sizeof(Job));
+    job->id = next_job_id++;
+    job->pid = pid;
+    job->fd = fd;
+    job->ring_size = JOB_RING_SIZE;
+    job->ring = malloc(job->ring_size);
+    job->spill_fd = -1;
+    job->running = 1;
+
+    size_t len = 0;
+    for (int i = 0; argv[i] != NULL; i++)
+        len += strlen(argv[i]) + 1;
+    job->command = malloc(len + 1);
+    job->command[0] = '\0';
+    for (int i = 0; argv[i] != NULL; i++) {
+        if (i > 0)
+            strcat(job->command, " ");
+        strcat(job->command, argv[i]);
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef F_SETPIPE_SZ
+    fcntl(fd, F_SETPIPE_SZ, JOB_PIPE_SIZE);
+#endif
+#ifdef __linux__
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = job;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+#endif
+    open_pipes++;
+
+    jobs[job_count++] = job;
+    return job;
+}
+
+/**
+ * @brief Espera salida de los trabajos y la copia a sus búferes
+ * @param timeout Milisegundos máximos de espera (0 para no esperar)
+ */
+void jobs_poll(int timeout) {
+    if (open_pipes > 0)
+        jobs_wait(-1, timeout);
+}
+
+/**
+ * @brief Recoge los trabajos terminados e informa de ellos
+ *
+ * Se llama antes de mostrar el prompt, así el aviso nunca se escribe
+ * en medio de la línea que se está editando.
+ */
+void jobs_notify(void) {
+    jobs_poll(0);
+    for (int i = 0; i < job_count; i++) {
+        Job *job = jobs[i];
+        int status;
+        if (job->running && waitpid(job->pid, &status, WNOHANG) == job->pid) {
+            job->running = 0;
+            job->status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        }
+        if (!job->running && !job->notified) {
+            printf("[%d]  Hecho (estado %d)  %s\n", job->id, job->status, job->command);
+            job->notified = 1;
+        }
+    }
+}
+
+/**
+ * @brief Busca un trabajo por su número
+ * @param spec Número del trabajo ("N" o "%N"); NULL para el más reciente
+ * @return Trabajo encontrado o NULL si no existe
+ */
+Job *job_find(const char *spec) {
+    if (spec == NULL)
+        return job_count > 0 ? jobs[job_count - 1] : NULL;
+
+    if (*spec == '%')
+        spec++;
+    char *end;
+    long id = strtol(spec, &end, 10);
+    if (*spec == '\0' || *end != '\0')
+        return NULL;
+    for (int i = 0; i < job_count; i++) {
+        if (jobs[i]->id == id)
+            return jobs[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief Muestra los trabajos y su estado
+ */
+void jobs_list(void) {
+    jobs_notify();
+    for (int i = 0; i < job_count; i++) {
+        Job *job = jobs[i];
+        printf("[%d]  %-10s %12llu bytes  %s\n", job->id, job->running ? "Ejecutando" : "Hecho",
+               (unsigned long long)job->head, job->command);
+    }
+}
+
+/**
+ * @brief Escribe en stdout la salida de un trabajo entre dos posiciones
+ * @param job Trabajo
+ * @param from Posición absoluta inicial
+ * @param to Posición absoluta final (como mucho head)
+ *
+ * Los bytes anteriores a tail se leen del archivo temporal; los que se
+ * descartaron se sustituyen por un aviso en stderr.
+ */
+static void job_write_range(Job *job, uint64_t from, uint64_t to) {
+    char buffer[64 * 1024];
+
+    fflush(stdout);
+    while (from < to && from < job->spilled) {
+        uint64_t end = to < job->spilled ? to : job->spilled;
+        size_t len = end - from > sizeof(buffer) ? sizeof(buffer) : end - from;
+        ssize_t n = pread(job->spill_fd, buffer, len, from);
+        if (n <= 0)
+            break;
+        if (write_all(STDOUT_FILENO, buffer, n) < 0)
+            return;
+        from += n;
+    }
+
+    if (from < to && from < job->tail) {
+        uint64_t end = to < job->tail ? to : job->tail;
+        fprintf(stderr, "\n[... %llu bytes descartados ...]\n", (unsigned long long)(end - from));
+        from = end;
+    }
+
+    while (from < to) {
+        size_t offset = from & (job->ring_size - 1);
+        size_t len = job->ring_size - offset;
+        if (len > to - from)
+            len = to - from;
+        if (write_all(STDOUT_FILENO, job->ring + offset, len) < 0)
+            return;
+        from += len;
+    }
+}
+
+/**
+ * @brief Busca dónde empiezan las últimas líneas del búfer
+ * @param job Trabajo
+ * @param lines Número de líneas
+ * @return Posición absoluta del inicio de la primera línea a mostrar
+ */
+static uint64_t job_tail_start(Job *job, int lines) {
+    uint64_t pos = job->head;
+    size_t mask = job->ring_size - 1;
+
+    // Un salto de línea final no cuenta como una línea más
+    if (pos > job->tail && job->ring[(pos - 1) & mask] == '\n')
+        pos--;
+    while (pos > job->tail) {
+        if (job->ring[(pos - 1) & mask] == '\n' && --lines <= 0)
+            break;
+        pos--;
+    }
+    return pos;
+}
+
+/**
+ * @brief Muestra las últimas líneas capturadas de un trabajo
+ * @param job Trabajo
+ * @param lines Número de líneas
+ *
+ * Solo se buscan en el búfer (la parte más reciente de la salida).
+ */
+void job_tail(Job *job, int lines) {
+    jobs_poll(0);
+    if (lines > 0)
+        job_write_range(job, job_tail_start(job, lines), job->head);
+}
+
+/**
+ * @brief Muestra toda la salida capturada de un trabajo
+ * @param job Trabajo
+ */
+void job_dump(Job *job) {
+    jobs_poll(0);
+    job_write_range(job, 0, job->head);
+}
+
+/**
+ * @brief Muestra la salida de un trabajo a medida que llega
+ * @param job Trabajo
+ *
+ * Como tail -f: muestra las últimas líneas y después lo que se vaya
+ * capturando. Termina cuando el trabajo cierra su salida o con Ctrl+C.
+ */
+void job_stream(Job *job) {
+    jobs_poll(0);
+    uint64_t pos = job_tail_start(job, JOB_STREAM_LINES);
+
+    foreground_process_running = 1;
+    last_command_status = 0;
+    while (!vm_interrupted) {
+        if (job->head > pos) {
+            job_write_range(job, pos, job->head);
+            pos = job->head;
+        }
+        if (job->fd < 0)
+            break;
+        jobs_poll(100);
+    }
+    foreground_process_running = 0;
+}
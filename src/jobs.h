@@ -0,0 +1,107 @@
+/**
+ * @file jobs.h
+ * @brief Definición de la captura de salida de los procesos en segundo plano
+ *
+ * La salida estándar y de error de cada comando lanzado con & se recoge
+ * por una tubería en un búfer circular propio del trabajo, en lugar de
+ * escribirse sobre el prompt. Cuando el búfer se llena, los datos más
+ * antiguos pasan a un archivo temporal, de modo que la salida completa
+ * se puede consultar después con jobdump.
+ */
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "shell.h"
+
+/**
+ * @brief Trabajo en segundo plano con su salida capturada
+ */
+typedef struct Job {
+    /** Número del trabajo (el que se muestra como [N]) */
+    int id;
+    /** PID del proceso (se conserva al recoger su estado: eso lo indica running) */
+    pid_t pid;
+    /** Línea de comando, para mostrarla en jobs */
+    char *command;
+    /** Extremo de lectura de la tubería (-1 cuando llegó al final) */
+    int fd;
+    /** Búfer circular con la salida más reciente */
+    char *ring;
+    /** Capacidad del búfer (potencia de 2) */
+    size_t ring_size;
+    /** Posición absoluta del siguiente byte a escribir (bytes totales capturados) */
+    uint64_t head;
+    /** Posición absoluta del byte más antiguo que sigue en el búfer */
+    uint64_t tail;
+    /** Archivo temporal con el principio de la salida (-1 si no hay, -2 si no se pudo crear) */
+    int spill_fd;
+    /** Bytes guardados en el archivo temporal (las posiciones [0, spilled)) */
+    uint64_t spilled;
+    /** Indica si el proceso sigue en ejecución */
+    int running;
+    /** Estado de salida del proceso */
+    int status;
+    /** Indica si ya se informó de que terminó */
+    int notified;
+} Job;
+
+/**
+ * @brief Prepara la captura de trabajos e integra su lectura con readline
+ */
+void jobs_init(void);
+
+/**
+ * @brief Registra un trabajo recién lanzado
+ * @param pid PID del proceso hijo
+ * @param fd Extremo de lectura de la tubería conectada a su stdout y stderr
+ * @param argv Argumentos del comando
+ * @return Trabajo registrado
+ */
+Job *job_start(pid_t pid, int fd, char **argv);
+
+/**
+ * @brief Espera salida de los trabajos y la copia a sus búferes
+ * @param timeout Milisegundos máximos de espera (0 para no esperar)
+ */
+void jobs_poll(int timeout);
+
+/**
+ * @brief Recoge los trabajos terminados e informa de ellos
+ */
+void jobs_notify(void);
+
+/**
+ * @brief Busca un trabajo por su número
+ * @param spec Número del trabajo ("N" o "%N"); NULL para el más reciente
+ * @return Trabajo encontrado o NULL si no existe
+ */
+Job *job_find(const char *spec);
+
+/**
+ * @brief Muestra los trabajos y su estado
+ */
+void jobs_list(void);
+
+/**
+ * @brief Muestra las últimas líneas capturadas de un trabajo
+ * @param job Trabajo
+ * @param lines Número de líneas
+ */
+void job_tail(Job *job, int lines);
+
+/**
+ * @brief Muestra toda la salida capturada de un trabajo
+ * @param job Trabajo
+ */
+void job_dump(Job *job);
+
+/**
+ * @brief Muestra la salida de un trabajo a medida que llega
+ * @param job Trabajo
+ *
+ * Termina cuando el trabajo cierra su salida o con Ctrl+C.
+ */
+void job_stream(Job *job);
+
+#endif // JOBS_H
@@ -0,0 +1,941 @@
+/**
+ * @file server.c
+ * @brief Implementación del modo servidor (dwimsh --server) y de su cliente
+ *
+ * El servidor es un único proceso con un bucle de eventos epoll que
+ * multiplexa el socket de escucha, las conexiones de los clientes, las
+ * tuberías de captura y las señales (signalfd). Cada conexión lleva su
+ * propia máquina de estados: leyendo una petición, ejecutándola y
+ * escribiendo la respuesta; así se pueden atender muchas peticiones a la
+ * vez sin hilos.
+ *
+ * La línea se compila en el servidor (queda en la caché de programas) y
+ * se ejecuta en un hijo creado con fork. El hijo recibe directamente los
+ * descriptores que el cliente envió con SCM_RIGHTS, de modo que la
+ * entrada y la salida del comando no pasan por el servidor. Solo con
+ * SERVER_CAPTURE la salida se recoge en una tubería y vuelve en la
+ * respuesta.
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "server.h"
+#include "vars.h"
+#include "vm.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#endif
+
+/**
+ * @brief Ruta del socket por defecto
+ * @return $DWIMSH_SOCKET, $XDG_RUNTIME_DIR/dwimsh.sock o /tmp/dwimsh-UID/dwimsh.sock;
+ *         NULL si el directorio de /tmp no es privado del usuario
+ *
+ * El directorio de /tmp se crea con permisos 0700. Si ya existe, tiene que
+ * ser un directorio (no un enlace) del usuario y sin permisos para nadie
+ * más; si no, otro usuario podría haberlo preparado para suplantar al
+ * servidor.
+ */
+const char *server_socket_path(void) {
+    static char path[108];
+    const char *env = getenv("DWIMSH_SOCKET");
+    if (env != NULL && *env)
+        return env;
+
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    if (runtime != NULL && *runtime) {
+        snprintf(path, sizeof(path), "%s/dwimsh.sock", runtime);
+        return path;
+    }
+
+    char dir[64];
+    struct stat st;
+    snprintf(dir, sizeof(dir), "/tmp/dwimsh-%d", (int)getuid());
+    if (mkdir(dir, 0700) < 0 && errno != EEXIST) {
+        fprintf(stderr, "dwimsh: %s: %s\n", dir, strerror(errno));
+        return NULL;
+    }
+    if (lstat(dir, &st) < 0 || !S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 0077) != 0) {
+        fprintf(stderr, "dwimsh: %s: no es un directorio privado del usuario\n", dir);
+        return NULL;
+    }
+    snprintf(path, sizeof(path), "%s/dwimsh.sock", dir);
+    return path;
+}
+
+/**
+ * @brief Usuario del proceso al otro lado de un socket Unix conectado
+ * @param fd Socket
+ * @return UID del otro proceso o (uid_t)-1 si no se pudo saber
+ */
+static uid_t peer_uid(int fd) {
+#ifdef __linux__
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0)
+        return (uid_t)-1;
+    return cred.uid;
+#else
+    uid_t uid;
+    gid_t gid;
+    if (getpeereid(fd, &uid, &gid) < 0)
+        return (uid_t)-1;
+    return uid;
+#endif
+}
+
+/**
+ * @brief Rellena la dirección de un socket Unix
+ * @param addr Dirección a rellenar
+ * @param path Ruta del socket
+ * @return 0 si la ruta cabe, -1 si es demasiado larga
+ */
+static int socket_address(struct sockaddr_un *addr, const char *path) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        fprintf(stderr, "dwimsh: %s: ruta de socket demasiado larga\n", path);
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+#ifdef __linux__
+
+// Eventos que se procesan en cada vuelta del bucle
+#define SERVER_EVENTS 64
+
+// Tamaño inicial del búfer de entrada de cada conexión
+#define SERVER_INPUT_INITIAL 4096
+
+/**
+ * @brief Estado de una conexión
+ */
+typedef enum {
+    CLIENT_READING,   /**< Esperando (o leyendo) una petición */
+    CLIENT_RUNNING,   /**< Ejecutando la petición en un hijo */
+    CLIENT_WRITING    /**< Enviando la respuesta */
+} ClientState;
+
+struct Client;
+
+/**
+ * @brief Descriptor registrado en epoll y a qué pertenece
+ */
+typedef struct Watch {
+    /** 0 socket de escucha, 1 señales, 2 conexión, 3 tubería de captura */
+    int kind;
+    struct Client *client;
+} Watch;
+
+/**
+ * @brief Conexión de un cliente
+ */
+typedef struct Client {
+    /** Socket de la conexión */
+    int fd;
+    ClientState state;
+    /** Datos recibidos que aún no forman parte de una petición atendida */
+    char *in;
+    size_t in_len;
+    size_t in_cap;
+    /** Descriptores recibidos con la petición en curso */
+    int fds[3];
+    int nfds;
+    /** Hijo que ejecuta la petición (0 si ya terminó) */
+    pid_t pid;
+    /** Estado de salida de la petición */
+    int status;
+    /** Extremo de lectura de la tubería de captura (-1 si no hay o ya se cerró) */
+    int capture_fd;
+    /** Respuesta: cabecera más salida capturada */
+    char *out;
+    size_t out_len;
+    size_t out_cap;
+    size_t out_sent;
+    int truncated;
+    /** El cliente cerró la conexión: se libera cuando termine su hijo */
+    int closed;
+    /** Ya liberada: se descarta al final de la vuelta del bucle */
+    int dead;
+    Watch sock_watch;
+    Watch capture_watch;
+    struct Client *next;
+} Client;
+
+static int epoll_fd = -1;
+static int listen_fd = -1;
+static int signal_fd = -1;
+static Client *clients = NULL;
+// Conexiones liberadas durante la vuelta actual del bucle (pueden tener eventos pendientes)
+static Client *dead_clients = NULL;
+static sigset_t saved_mask;
+
+/**
+ * @brief Registra o modifica un descriptor en epoll
+ * @param op EPOLL_CTL_ADD o EPOLL_CTL_MOD
+ * @param fd Descriptor
+ * @param events Eventos de interés
+ * @param watch A qué pertenece el descriptor
+ */
+static void watch_fd(int op, int fd, uint32_t events, Watch *watch) {
+    struct epoll_event event;
+    event.events = events;
+    event.data.ptr = watch;
+    if (epoll_ctl(epoll_fd, op, fd, &event) < 0)
+        perror("epoll_ctl");
+}
+
+/**
+ * @brief Cierra los descriptores recibidos con una petición
+ * @param c Conexión
+ */
+static void close_passed_fds(Client *c) {
+    for (int i = 0; i < c->nfds; i++)
+        close(c->fds[i]);
+    c->nfds = 0;
+}
+
+/**
+ * @brief Libera una conexión (su hijo, si lo hay, ya no tiene a quién responder)
+ * @param c Conexión
+ *
+ * La memoria se libera al final de la vuelta del bucle, porque entre los
+ * eventos ya recibidos puede haber otros de la misma conexión.
+ */
+static void client_free(Client *c) {
+    for (Client **p = &clients; *p; p = &(*p)->next) {
+        if (*p == c) {
+            *p = c->next;
+            break;
+        }
+    }
+    // Los hijos pueden conservar copias de estos descriptores: hay que quitarlos de epoll a mano
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    if (c->capture_fd >= 0) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->capture_fd, NULL);
+        close(c->capture_fd);
+    }
+    close_passed_fds(c);
+    c->dead = 1;
+    c->next = dead_clients;
+    dead_clients = c;
+}
+
+/**
+ * @brief Libera la memoria de las conexiones cerradas en la última vuelta del bucle
+ */
+static void clients_collect(void) {
+    while (dead_clients != NULL) {
+        Client *c = dead_clients;
+        dead_clients = c->next;
+        free(c->in);
+        free(c->out);
+        free(c);
+    }
+}
+
+/**
+ * @brief Cierra una conexión; si tiene una petición en curso, la termina
+ * @param c Conexión
+ *
+ * El hijo se lanza en su propio grupo de procesos, así que se termina con
+ * todo lo que haya lanzado. La conexión se libera al recoger su estado.
+ */
+static void client_close(Client *c) {
+    if (c->pid > 0) {
+        kill(-c->pid, SIGHUP);
+        c->closed = 1;
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+        return;
+    }
+    client_free(c);
+}
+
+/**
+ * @brief Añade bytes a la respuesta de una conexión
+ * @param c Conexión
+ * @param data Bytes
+ * @param n Número de bytes
+ */
+static void output_append(Client *c, const char *data, size_t n) {
+    if (c->out_len + n > c->out_cap) {
+        while (c->out_len + n > c->out_cap)
+            c->out_cap = c->out_cap ? c->out_cap * 2 : 4096;
+        c->out = realloc(c->out, c->out_cap);
+    }
+    memcpy(c->out + c->out_len, data, n);
+    c->out_len += n;
+}
+
+/**
+ * @brief Envía lo que quede de la respuesta; al terminar vuelve a esperar peticiones
+ * @param c Conexión
+ */
+static void client_flush(Client *c);
+
+/**
+ * @brief Completa la respuesta cuando el hijo terminó y la tubería de captura se cerró
+ * @param c Conexión
+ */
+static void client_finish(Client *c) {
+    if (c->pid != 0 || c->capture_fd >= 0)
+        return;
+    if (c->closed) {
+        client_free(c);
+        return;
+    }
+
+    ServerResponse *resp = (ServerResponse *)c->out;
+    resp->magic = SERVER_MAGIC;
+    resp->status = c->status;
+    resp->length = c->out_len - sizeof(ServerResponse);
+    resp->truncated = c->truncated;
+    c->out_sent = 0;
+    c->state = CLIENT_WRITING;
+    client_flush(c);
+}
+
+/**
+ * @brief Ejecuta una petición en un hijo
+ * @param c Conexión con la petición completa al principio de c->in
+ * @param req Cabecera de la petición
+ *
+ * La línea se compila en el servidor, con la salida de error apuntando al
+ * cliente para que los errores de sintaxis le lleguen a él.
+ */
+static void client_execute(Client *c, const ServerRequest *req) {
+    char *line = c->in + sizeof(ServerRequest);
+    char *end = line + req->length;
+
+    // Con el último byte a '\0' todas las cadenas terminan dentro de la petición
+    int valid = req->length > 0 && end[-1] == '\0';
+    char *cwd = valid ? line + strlen(line) + 1 : end;
+    char *env = cwd < end ? cwd + strlen(cwd) + 1 : end;
+    valid = valid && cwd < end;
+
+    // Mientras tanto solo se vigila que el cliente no cuelgue
+    c->state = CLIENT_RUNNING;
+    watch_fd(EPOLL_CTL_MOD, c->fd, EPOLLRDHUP, &c->sock_watch);
+    c->out_len = 0;
+    c->truncated = 0;
+    c->status = 0;
+    output_append(c, (const char *)&(ServerResponse){0}, sizeof(ServerResponse));
+
+    // Descriptores del hijo: los recibidos, la tubería de captura o /dev/null
+    int capture[2] = {-1, -1};
+    if ((req->flags & SERVER_CAPTURE) && pipe2(capture, O_CLOEXEC) < 0)
+        perror("pipe2");
+    int null_fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+    int child_fds[3];
+    for (int i = 0; i < 3; i++) {
+        if (i < c->nfds)
+            child_fds[i] = c->fds[i];
+        else if (i > 0 && capture[1] >= 0)
+            child_fds[i] = capture[1];
+        else
+            child_fds[i] = null_fd;
+    }
+
+    // Compilar (o tomar de la caché) con los errores dirigidos al cliente
+    int saved_stderr = dup(STDERR_FILENO);
+    dup2(child_fds[2], STDERR_FILENO);
+    int result = -1;
+    Program *prog = NULL;
+    if (valid)
+        prog = program_cache_lookup(line, &result);
+    else
+        fprintf(stderr, "dwimsh: petición mal formada\n");
+    if (result == 0)
+        fprintf(stderr, "dwimsh: fin de archivo inesperado\n");
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+
+    if (prog != NULL) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            c->status = 1;
+        } else if (pid == 0) {
+            sigprocmask(SIG_SETMASK, &saved_mask, NULL);
+            signal(SIGPIPE, SIG_DFL);
+            setpgid(0, 0);
+
+            // El hijo no debe mantener abiertas las conexiones de otros clientes
+            for (Client *other = clients; other; other = other->next) {
+                if (other != c) {
+                    close(other->fd);
+                    if (other->capture_fd >= 0)
+                        close(other->capture_fd);
+                }
+            }
+            close(listen_fd);
+            close(signal_fd);
+            close(epoll_fd);
+            close(c->fd);
+            if (capture[0] >= 0)
+                close(capture[0]);
+
+            for (int i = 0; i < 3; i++)
+                dup2(child_fds[i], i);
+
+            if (chdir(cwd) < 0) {
+                fprintf(stderr, "dwimsh: cd: %s: %s\n", cwd, strerror(errno));
+                exit(1);
+            }
+            for (char *var = env; var < end; var += strlen(var) + 1) {
+                char *eq = strchr(var, '=');
+                if (eq == NULL) {
+                    var_unset(var);
+                } else {
+                    *eq = '\0';
+                    var_set(var, eq + 1, 1);
+                }
+            }
+
+            vm_execute(prog);
+            fflush(stdout);
+            exit(last_command_status);
+        } else {
+            // También desde el padre, para que kill(-pid) no llegue antes que el hijo
+            setpgid(pid, pid);
+            c->pid = pid;
+        }
+    } else {
+        c->status = 2;
+    }
+
+    close(null_fd);
+    close_passed_fds(c);
+    if (capture[1] >= 0)
+        close(capture[1]);
+    if (capture[0] >= 0) {
+        c->capture_fd = capture[0];
+        watch_fd(EPOLL_CTL_ADD, c->capture_fd, EPOLLIN, &c->capture_watch);
+    }
+
+    // Quitar la petición atendida del búfer de entrada
+    size_t used = sizeof(ServerRequest) + req->length;
+    memmove(c->in, c->in + used, c->in_len - used);
+    c->in_len -= used;
+
+    client_finish(c);
+}
+
+/**
+ * @brief Atiende la petición de una conexión, que ya llegó completa y con la cabecera validada
+ * @param c Conexión
+ */
+static void client_dispatch(Client *c) {
+    ServerRequest req;
+    memcpy(&req, c->in, sizeof(req));
+    if (c->nfds != (int)req.nfds) {
+        fprintf(stderr, "dwimsh: la petición no trae los descriptores anunciados\n");
+        client_close(c);
+        return;
+    }
+    client_execute(c, &req);
+}
+
+static void client_flush(Client *c) {
+    while (c->out_sent < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_sent, c->out_len - c->out_sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                watch_fd(EPOLL_CTL_MOD, c->fd, EPOLLOUT | EPOLLRDHUP, &c->sock_watch);
+                return;
+            }
+            client_close(c);
+            return;
+        }
+        c->out_sent += n;
+    }
+
+    watch_fd(EPOLL_CTL_MOD, c->fd, EPOLLIN, &c->sock_watch);
+    c->state = CLIENT_READING;
+    c->out_len = 0;
+}
+
+/**
+ * @brief Lee de una conexión la petición en curso y sus descriptores
+ * @param c Conexión
+ *
+ * Cada conexión tiene como mucho una petición pendiente: nunca se lee más
+ * allá del final de la petición en curso, y el socket no se vuelve a leer
+ * hasta enviar su respuesta. Lo que el cliente haya enviado después (con
+ * sus descriptores) espera en el socket a la siguiente vuelta.
+ */
+static void client_read(Client *c) {
+    for (;;) {
+        size_t want = sizeof(ServerRequest);
+        if (c->in_len >= want) {
+            ServerRequest req;
+            memcpy(&req, c->in, sizeof(req));
+            if (req.magic != SERVER_MAGIC || req.length > SERVER_MAX_REQUEST || req.nfds > 3) {
+                fprintf(stderr, "dwimsh: petición no válida, se cierra la conexión\n");
+                client_close(c);
+                return;
+            }
+            want += req.length;
+        }
+        if (c->in_len == want)
+            break;
+        if (want > c->in_cap) {
+            c->in_cap = want > SERVER_INPUT_INITIAL ? want : SERVER_INPUT_INITIAL;
+            c->in = realloc(c->in, c->in_cap);
+        }
+
+        char control[CMSG_SPACE(3 * sizeof(int))];
+        struct iovec iov = {c->in + c->in_len, want - c->in_len};
+        struct msghdr msg = {0};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t n = recvmsg(c->fd, &msg, MSG_CMSG_CLOEXEC);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (n <= 0) {
+            client_close(c);
+            return;
+        }
+
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS)
+                continue;
+            int count = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            int *received = (int *)CMSG_DATA(cm);
+            for (int i = 0; i < count; i++) {
+                if (c->nfds < 3)
+                    c->fds[c->nfds++] = received[i];
+                else
+                    close(received[i]);
+            }
+        }
+        c->in_len += n;
+    }
+    client_dispatch(c);
+}
+
+/**
+ * @brief Acepta todas las conexiones pendientes
+ */
+static void server_accept(void) {
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                perror("accept4");
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        // El socket ya es 0600; esto cubre además el instante entre bind y chmod
+        if (peer_uid(fd) != getuid()) {
+            close(fd);
+            continue;
+        }
+        Client *c = calloc(1, sizeof(Client));
+        c->fd = fd;
+        c->capture_fd = -1;
+        c->state = CLIENT_READING;
+        c->sock_watch = (Watch){2, c};
+        c->capture_watch = (Watch){3, c};
+        c->next = clients;
+        clients = c;
+        watch_fd(EPOLL_CTL_ADD, fd, EPOLLIN, &c->sock_watch);
+    }
+}
+
+/**
+ * @brief Vacía la tubería de captura de una conexión
+ * @param c Conexión
+ */
+static void capture_read(Client *c) {
+    char buf[65536];
+
+    // Una sola lectura por aviso, para repartir el tiempo entre conexiones
+    ssize_t n = read(c->capture_fd, buf, sizeof(buf));
+    if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+        return;
+    if (n <= 0) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->capture_fd, NULL);
+        close(c->capture_fd);
+        c->capture_fd = -1;
+        client_finish(c);
+        return;
+    }
+    size_t room = sizeof(ServerResponse) + SERVER_MAX_CAPTURE - c->out_len;
+    if ((size_t)n > room) {
+        c->truncated = 1;
+        n = room;
+    }
+    if (!c->closed)
+        output_append(c, buf, n);
+}
+
+/**
+ * @brief Recoge los hijos terminados y completa sus peticiones
+ */
+static void server_reap(void) {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        for (Client *c = clients; c; c = c->next) {
+            if (c->pid != pid)
+                continue;
+            c->pid = 0;
+            c->status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+            client_finish(c);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Atiende peticiones en un socket Unix hasta recibir SIGINT o SIGTERM
+ * @param path Ruta del socket
+ * @return Estado de salida de la shell
+ *
+ * Antes de escuchar se cargan la lista de comandos y todas las rutas del
+ * PATH; las peticiones las heredan con fork ya construidas.
+ */
+int server_run(const char *path) {
+    struct sockaddr_un addr;
+    if (path == NULL || socket_address(&addr, path) < 0)
+        return 2;
+
+    interactive = 0;
+    bin_commands();
+    path_hash_fill();
+
+    // $0 de los comandos ejecutados
+    static char *shell_name = "dwimsh";
+    positional_params.argv = &shell_name;
+    positional_params.argc = 1;
+
+    // Las señales se reciben por signalfd dentro del bucle
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, &saved_mask);
+    signal(SIGPIPE, SIG_IGN);
+    signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0 || signal_fd < 0) {
+        perror("dwimsh: socket");
+        return 1;
+    }
+
+    // Un socket que quedó de un servidor anterior se reemplaza si nadie lo atiende
+    int probe = client_connect(path);
+    if (probe >= 0) {
+        close(probe);
+        fprintf(stderr, "dwimsh: %s: ya hay un servidor escuchando\n", path);
+        return 1;
+    }
+    unlink(path);
+
+    // Solo el usuario puede conectarse
+    mode_t old_umask = umask(0077);
+    int bound = bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(old_umask);
+    if (bound < 0 || listen(listen_fd, SOMAXCONN) < 0) {
+        fprintf(stderr, "dwimsh: %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    Watch listen_watch = {0, NULL}, signal_watch = {1, NULL};
+    watch_fd(EPOLL_CTL_ADD, listen_fd, EPOLLIN, &listen_watch);
+    watch_fd(EPOLL_CTL_ADD, signal_fd, EPOLLIN, &signal_watch);
+    fprintf(stderr, "dwimsh: servidor escuchando en %s\n", path);
+
+    struct epoll_event events[SERVER_EVENTS];
+    int running = 1;
+    while (running) {
+        int ready = epoll_wait(epoll_fd, events, SERVER_EVENTS, -1);
+        if (ready < 0 && errno == EINTR)
+            continue;
+        if (ready < 0) {
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < ready; i++) {
+            Watch *watch = events[i].data.ptr;
+            Client *c = watch->client;
+            if (c != NULL && c->dead)
+                continue;
+            switch (watch->kind) {
+            case 0:
+                server_accept();
+                break;
+            case 1: {
+                struct signalfd_siginfo info;
+                while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+                    if (info.ssi_signo != SIGCHLD)
+                        running = 0;
+                }
+                server_reap();
+                break;
+            }
+            case 2:
+                if (c->state != CLIENT_READING &&
+                    (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+                    client_close(c);
+                else if (events[i].events & EPOLLOUT)
+                    client_flush(c);
+                else if (c->state == CLIENT_READING)
+                    client_read(c);
+                break;
+            case 3:
+                capture_read(c);
+                break;
+            }
+        }
+        clients_collect();
+    }
+
+    while (clients != NULL) {
+        if (clients->pid > 0)
+            kill(-clients->pid, SIGHUP);
+        client_free(clients);
+    }
+    clients_collect();
+    close(listen_fd);
+    close(signal_fd);
+    close(epoll_fd);
+    unlink(path);
+    sigprocmask(SIG_SETMASK, &saved_mask, NULL);
+    return 0;
+}
+
+#else
+
+int server_run(const char *path) {
+    (void)path;
+    fprintf(stderr, "dwimsh: --server solo está disponible en Linux\n");
+    return 2;
+}
+
+#endif
+
+int client_connect(const char *path) {
+    struct sockaddr_un addr;
+    if (socket_address(&addr, path) < 0)
+        return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    // Antes de enviarle descriptores y entorno: el servidor tiene que ser del mismo usuario
+    if (peer_uid(fd) != getuid()) {
+        fprintf(stderr, "dwimsh: %s: el servidor es de otro usuario\n", path);
+        close(fd);
+        errno = EPERM;
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Lee exactamente n bytes de un descriptor
+ * @param fd Descriptor
+ * @param buf Destino
+ * @param n Bytes a leer
+ * @return 0 si se leyeron todos, -1 si hubo un error o fin de archivo
+ */
+static int read_full(int fd, void *buf, size_t n) {
+    char *p = buf;
+    while (n > 0) {
+        ssize_t r = read(fd, p, n);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return -1;
+        p += r;
+        n -= r;
+    }
+    return 0;
+}
+
+int client_request(int sock, const char *line, const char *cwd, char **env, int nenv,
+                   int flags, const int *fds, int nfds, int *status, char **output, size_t *output_len) {
+    size_t length = strlen(line) + 1 + strlen(cwd) + 1;
+    for (int i = 0; i < nenv; i++)
+        length += strlen(env[i]) + 1;
+    if (length > SERVER_MAX_REQUEST) {
+        fprintf(stderr, "dwimsh: petición demasiado grande\n");
+        return -1;
+    }
+
+    char *buf = malloc(sizeof(ServerRequest) + length);
+    ServerRequest req = {SERVER_MAGIC, flags, length, nfds};
+    memcpy(buf, &req, sizeof(req));
+    char *p = buf + sizeof(req);
+    p = stpcpy(p, line) + 1;
+    p = stpcpy(p, cwd) + 1;
+    for (int i = 0; i < nenv; i++)
+        p = stpcpy(p, env[i]) + 1;
+
+    // Los descriptores viajan con el primer bloque
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    size_t total = sizeof(ServerRequest) + length, sent = 0;
+    while (sent < total) {
+        struct iovec iov = {buf + sent, total - sent};
+        struct msghdr msg = {0};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        if (sent == 0 && nfds > 0) {
+            memset(control, 0, sizeof(control));
+            msg.msg_control = control;
+            msg.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+            struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+            cm->cmsg_level = SOL_SOCKET;
+            cm->cmsg_type = SCM_RIGHTS;
+            cm->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+            memcpy(CMSG_DATA(cm), fds, nfds * sizeof(int));
+        }
+        ssize_t n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            free(buf);
+            return -1;
+        }
+        sent += n;
+    }
+    free(buf);
+
+    ServerResponse resp;
+    if (read_full(sock, &resp, sizeof(resp)) < 0 || resp.magic != SERVER_MAGIC)
+        return -1;
+    char *data = malloc(resp.length + 1);
+    if (read_full(sock, data, resp.length) < 0) {
+        free(data);
+        return -1;
+    }
+    data[resp.length] = '\0';
+
+    *status = resp.status;
+    if (output != NULL) {
+        *output = data;
+        *output_len = resp.length;
+    } else {
+        free(data);
+    }
+    return 0;
+}
+
+/**
+ * @brief Modo cliente: dwimsh --client [-o] [-s socket] [-e NOMBRE=valor] [-u NOMBRE] comando...
+ * @param argc Número de argumentos de la shell
+ * @param argv Argumentos de la shell
+ * @return Estado de salida del comando ejecutado por el servidor
+ *
+ * Sin -o el comando escribe directamente en la salida del cliente (sus
+ * descriptores se pasan al servidor). Con -o la salida se captura y el
+ * cliente la escribe al recibir la respuesta.
+ */
+int client_run(int argc, char *argv[]) {
+    const char *path = NULL;
+    int flags = 0;
+    char **env = malloc(argc * sizeof(char *));
+    int nenv = 0;
+    int i = 2;
+
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-o") == 0) {
+            flags |= SERVER_CAPTURE;
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        } else if ((strcmp(argv[i], "-e") == 0 || strcmp(argv[i], "-u") == 0) && i + 1 < argc) {
+            if (argv[i][1] == 'e' && strchr(argv[i + 1], '=') == NULL) {
+                fprintf(stderr, "dwimsh: -e: se esperaba NOMBRE=valor\n");
+                free(env);
+                return 2;
+            }
+            env[nenv++] = argv[++i];
+        } else if (strcmp(argv[i], "--") == 0) {
+            i++;
+            break;
+        } else {
+            fprintf(stderr, "dwimsh: --client: opción no válida: %s\n", argv[i]);
+            free(env);
+            return 2;
+        }
+    }
+    if (i >= argc) {
+        fprintf(stderr, "uso: dwimsh --client [-o] [-s socket] [-e NOMBRE=valor] [-u NOMBRE] comando...\n");
+        free(env);
+        return 2;
+    }
+
+    // Los argumentos restantes forman la línea, como en sh -c "$*"
+    size_t len = 0;
+    for (int j = i; j < argc; j++)
+        len += strlen(argv[j]) + 1;
+    char *line = malloc(len);
+    line[0] = '\0';
+    for (int j = i; j < argc; j++) {
+        strcat(line, argv[j]);
+        if (j + 1 < argc)
+            strcat(line, " ");
+    }
+
+    if (path == NULL && (path = server_socket_path()) == NULL) {
+        free(line);
+        free(env);
+        return 2;
+    }
+
+    char cwd[4096];
+    if (getcwd(cwd, sizeof(cwd)) == NULL)
+        strcpy(cwd, "/");
+
+    int sock = client_connect(path);
+    if (sock < 0) {
+        fprintf(stderr, "dwimsh: no se pudo conectar con %s: %s\n", path, strerror(errno));
+        free(line);
+        free(env);
+        return 2;
+    }
+
+    int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    int status = 1;
+    char *output = NULL;
+    size_t output_len = 0;
+    int result = client_request(sock, line, cwd, env, nenv, flags, fds,
+                                (flags & SERVER_CAPTURE) ? 1 : 3, &status, &output, &output_len);
+    close(sock);
+    free(line);
+    free(env);
+    if (result < 0) {
+        fprintf(stderr, "dwimsh: el servidor cerró la conexión\n");
+        return 2;
+    }
+    fwrite(output, 1, output_len, stdout);
+    free(output);
+    return status;
+}
@@ -0,0 +1,118 @@
+/**
+ * @file server.h
+ * @brief Definición del modo servidor (dwimsh --server) y de su cliente
+ *
+ * Un proceso dwimsh de larga duración mantiene cargados la lista de
+ * comandos, la tabla de rutas de ejecutables y la caché de programas
+ * compilados, y ejecuta las líneas que le piden otros procesos por un
+ * socket Unix. Cada petición se ejecuta en un hijo creado con fork, que
+ * hereda todo ese estado sin tener que volver a construirlo.
+ *
+ * Protocolo (orden de bytes de la máquina, el socket es local):
+ *   petición:  ServerRequest + length bytes con "línea\0directorio\0" y
+ *              luego una entrada por variable, "NOMBRE=valor\0" para
+ *              definirla o "NOMBRE\0" para eliminarla. Con la cabecera
+ *              viajan (SCM_RIGHTS) nfds descriptores, que pasan a ser la
+ *              entrada, la salida y la salida de error del comando.
+ *   respuesta: ServerResponse + length bytes de salida capturada.
+ *
+ * Cada conexión atiende una sola petición a la vez: el servidor no lee la
+ * siguiente (ni sus descriptores) hasta haber enviado la respuesta de la
+ * anterior, así que un cliente puede encadenarlas sin mezclarlas.
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "shell.h"
+
+// Identifica las cabeceras del protocolo ("dwm1")
+#define SERVER_MAGIC 0x646d7731u
+
+// La salida y la salida de error se devuelven en la respuesta en lugar de escribirse en los descriptores
+#define SERVER_CAPTURE 1
+
+// Tamaño máximo de los datos de una petición
+#define SERVER_MAX_REQUEST (1024 * 1024)
+
+// Bytes máximos de salida capturada por petición (el resto se descarta)
+#define SERVER_MAX_CAPTURE (64 * 1024 * 1024)
+
+/**
+ * @brief Cabecera de una petición
+ */
+typedef struct ServerRequest {
+    /** SERVER_MAGIC */
+    uint32_t magic;
+    /** Opciones (SERVER_CAPTURE) */
+    uint32_t flags;
+    /** Bytes de datos que siguen a la cabecera */
+    uint32_t length;
+    /** Descriptores enviados con la cabecera (0 a 3: stdin, stdout, stderr) */
+    uint32_t nfds;
+} ServerRequest;
+
+/**
+ * @brief Cabecera de una respuesta
+ */
+typedef struct ServerResponse {
+    /** SERVER_MAGIC */
+    uint32_t magic;
+    /** Estado de salida (128 + señal si el comando terminó por una señal) */
+    int32_t status;
+    /** Bytes de salida capturada que siguen a la cabecera */
+    uint32_t length;
+    /** 1 si la salida capturada superó SERVER_MAX_CAPTURE y se recortó */
+    uint32_t truncated;
+} ServerResponse;
+
+/**
+ * @brief Ruta del socket por defecto
+ * @return $DWIMSH_SOCKET, $XDG_RUNTIME_DIR/dwimsh.sock o, sin ninguna de las
+ *         dos, /tmp/dwimsh-UID/dwimsh.sock (el directorio se crea con permisos
+ *         0700); NULL si ese directorio existe y no es privado del usuario
+ */
+const char *server_socket_path(void);
+
+/**
+ * @brief Atiende peticiones en un socket Unix hasta recibir SIGINT o SIGTERM
+ * @param path Ruta del socket
+ * @return Estado de salida de la shell
+ */
+int server_run(const char *path);
+
+/**
+ * @brief Se conecta a un servidor
+ * @param path Ruta del socket
+ * @return Descriptor del socket o -1 si no se pudo conectar o si el proceso
+ *         que escucha es de otro usuario (SO_PEERCRED)
+ */
+int client_connect(const char *path);
+
+/**
+ * @brief Envía una petición y espera su respuesta
+ * @param sock Socket conectado al servidor
+ * @param line Línea de comando
+ * @param cwd Directorio de trabajo del comando
+ * @param env Cambios de entorno ("NOMBRE=valor" o "NOMBRE")
+ * @param nenv Número de cambios de entorno
+ * @param flags Opciones (SERVER_CAPTURE)
+ * @param fds Descriptores que se pasan al comando
+ * @param nfds Número de descriptores (0 a 3)
+ * @param status Estado de salida del comando
+ * @param output Salida capturada (reservada con malloc) o NULL si no se quiere
+ * @param output_len Bytes de salida capturada
+ * @return 0 si se recibió la respuesta, -1 si hubo un error
+ */
+int client_request(int sock, const char *line, const char *cwd, char **env, int nenv,
+                   int flags, const int *fds, int nfds, int *status, char **output, size_t *output_len);
+
+/**
+ * @brief Modo cliente: dwimsh --client [-o] [-s socket] [-e NOMBRE=valor] [-u NOMBRE] comando...
+ * @param argc Número de argumentos de la shell
+ * @param argv Argumentos de la shell
+ * @return Estado de salida del comando ejecutado por el servidor
+ */
+int client_run(int argc, char *argv[]);
+
+#endif // SERVER_H
@@ -12,6 +12,13 @@
 #include "shell.h"
 #include "builtins.h"
 #include "suggestions.h"
+#include "vars.h"
+#include "expand.h"
+#include "vm.h"
+#include "jobs.h"
+#include "server.h"
+
+extern char **environ;
 
 // Variables globales
 char **commands = NULL;
@@ -20,6 +27,8 @@ pid_t current_child_pid = 0;
 int foreground_process_running = 0;
 int last_command_status = 0;
 volatile sig_atomic_t suggestion_interrupted = 0;
+int interactive = 1;
+int subshell = 0;
 
 /**
  * @brief Genera el prompt con color según el estado del último comando
@@ -42,12 +51,19 @@ char* get_colored_prompt() {
  * @param sig Número de señal recibida
  * 
  * Si hay un proceso en primer plano, envía la señal a ese proceso.
- * Si no, muestra un nuevo prompt limpio.
+ * Si hay un built-in o un bucle en ejecución, solo marca el error para
+ * que se detenga. Si no, muestra un nuevo prompt limpio.
  */
 void handle_sigint(int sig) {
     if (foreground_process_running && current_child_pid > 0) {
         kill(current_child_pid, SIGINT);
         last_command_status = 1;
+        vm_interrupted = 1;
+        printf("\n");
+    } else if (foreground_process_running || vm_depth > 0) {
+        // Un built-in (como sleep) o un bucle están en ejecución y terminarán por sí mismos
+        last_command_status = 1;
+        vm_interrupted = 1;
         printf("\n");
     } else {
         last_command_status = 1;
@@ -63,12 +79,20 @@ void handle_sigint(int sig) {
  * @brief Carga la lista de comandos disponibles del sistema
  * 
  * Busca en /usr/bin todos los archivos ejecutables y los carga en
- * la lista global de comandos disponibles. También añade los comandos
- * built-in a la lista.
+ * la lista global de comandos disponibles.
  */
 void bin_commands() {
-    const char *path = "/usr/bin";
+    load_commands("/usr/bin");
+}
 
+/**
+ * @brief Carga los comandos ejecutables de un directorio
+ * @param path Directorio a recorrer
+ *
+ * Los carga en la lista global de comandos disponibles y añade los
+ * comandos built-in de la tabla builtin_commands a la lista.
+ */
+void load_commands(const char *path) {
     command_count = 0; 
     struct dirent *entry;
     DIR *dir = opendir(path);
@@ -89,7 +113,7 @@ void bin_commands() {
     }
     closedir(dir);
 
-    commands = (char **)malloc((command_count + 4) * sizeof(char *));
+    commands = (char **)malloc((command_count + num_builtin_commands) * sizeof(char *));
 
     if (commands == NULL) {
         perror("Error al asignar memoria");
@@ -118,38 +142,181 @@ void bin_commands() {
         }
     }
     
-    commands[i] = strdup("pwd");
-    commands[i+1] = strdup("echo");
-    commands[i+2] = strdup("exit");
-    commands[i+3] = strdup("cd");
-    command_count += 4; // reserva para pwd, echo, exit, cd
     closedir(dir);
+
+    // Añadir los built-ins que no tengan ya un binario con el mismo nombre
+    int bin_count = i;
+    for (int b = 0; b < num_builtin_commands; b++) {
+        int duplicated = 0;
+        for (int j = 0; j < bin_count; j++) {
+            if (strcmp(commands[j], builtin_commands[b].name) == 0) {
+                duplicated = 1;
+                break;
+            }
+        }
+        if (!duplicated)
+            commands[i++] = strdup(builtin_commands[b].name);
+    }
+    command_count = i;
 }
 
+// Capacidad inicial de la tabla de rutas de ejecutables (potencia de 2)
+#define PATH_HASH_INITIAL 1024
+
 /**
- * @brief Verifica si un comando existe en el PATH del sistema
- * @param command Nombre del comando a verificar
- * @return 1 si existe, 0 si no existe
+ * @brief Entrada de la tabla de rutas de ejecutables
  */
-char command_exists(const char *command) {
-    char *path = getenv("PATH");
-    char *path_copy = strdup(path);
-    if (!path)
-        return 0;
-        
+typedef struct PathEntry {
+    char *name;
+    char *path;
+    unsigned int hash;
+} PathEntry;
+
+// Tabla nombre → ruta completa, como el hash de bash
+static PathEntry *path_table = NULL;
+static size_t path_capacity = 0;
+static size_t path_count = 0;
+// Valor de PATH con el que se llenó la tabla
+static char *path_table_path = NULL;
+
+/**
+ * @brief Vacía la tabla de rutas si PATH cambió desde que se llenó
+ */
+static void path_hash_check(void) {
+    const char *path = getenv("PATH");
+    if (path_table != NULL && (path == NULL ? path_table_path == NULL
+                               : path_table_path != NULL && strcmp(path_table_path, path) == 0))
+        return;
+
+    for (size_t i = 0; i < path_capacity; i++) {
+        free(path_table[i].name);
+        free(path_table[i].path);
+    }
+    free(path_table);
+    free(path_table_path);
+    path_capacity = PATH_HASH_INITIAL;
+    path_table = calloc(path_capacity, sizeof(PathEntry));
+    path_count = 0;
+    path_table_path = path ? strdup(path) : NULL;
+}
+
+/**
+ * @brief Añade una ruta a la tabla si el nombre no estaba (gana el primer directorio del PATH)
+ * @param name Nombre del comando
+ * @param len Longitud del nombre
+ * @param hash Hash del nombre calculado con hash_bytes
+ * @param path Ruta completa del ejecutable
+ * @return Ruta guardada en la tabla
+ */
+static const char *path_hash_insert(const char *name, size_t len, unsigned int hash, const char *path) {
+    if ((path_count + 1) * 2 > path_capacity) {
+        PathEntry *old = path_table;
+        size_t old_capacity = path_capacity;
+        path_capacity *= 2;
+        path_table = calloc(path_capacity, sizeof(PathEntry));
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old[i].name == NULL)
+                continue;
+            size_t j = old[i].hash & (path_capacity - 1);
+            while (path_table[j].name != NULL)
+                j = (j + 1) & (path_capacity - 1);
+            path_table[j] = old[i];
+        }
+        free(old);
+    }
+
+    size_t i = hash & (path_capacity - 1);
+    while (path_table[i].name != NULL) {
+        if (path_table[i].hash == hash && strcmp(path_table[i].name, name) == 0)
+            return path_table[i].path;
+        i = (i + 1) & (path_capacity - 1);
+    }
+    path_table[i].name = strndup(name, len);
+    path_table[i].path = strdup(path);
+    path_table[i].hash = hash;
+    path_count++;
+    return path_table[i].path;
+}
+
+/**
+ * @brief Llena la tabla de rutas con todos los ejecutables del PATH
+ *
+ * La usa el modo servidor para que ninguna petición tenga que recorrer
+ * los directorios del PATH.
+ */
+void path_hash_fill(void) {
+    path_hash_check();
+    if (path_table_path == NULL)
+        return;
+
+    char *path_copy = strdup(path_table_path);
+    char full[1024];
+    struct stat st;
+    for (char *dir = strtok(path_copy, ":"); dir; dir = strtok(NULL, ":")) {
+        DIR *d = opendir(dir);
+        if (d == NULL)
+            continue;
+        struct dirent *entry;
+        while ((entry = readdir(d)) != NULL) {
+            if (entry->d_name[0] == '.')
+                continue;
+            snprintf(full, sizeof(full), "%s/%s", dir, entry->d_name);
+            if (stat(full, &st) == 0 && S_ISREG(st.st_mode) && access(full, X_OK) == 0) {
+                size_t len = strlen(entry->d_name);
+                path_hash_insert(entry->d_name, len, hash_bytes(entry->d_name, len), full);
+            }
+        }
+        closedir(d);
+    }
+    free(path_copy);
+}
+
+/**
+ * @brief Busca la ruta completa de un comando en el PATH
+ * @param command Nombre del comando (sin '/')
+ * @return Ruta del ejecutable (propiedad de la tabla) o NULL si no está en el PATH
+ *
+ * Las rutas encontradas se guardan en una tabla hash, así que solo la
+ * primera búsqueda de cada comando recorre los directorios del PATH. La
+ * tabla se vacía si cambia PATH.
+ */
+const char *command_path(const char *command) {
+    path_hash_check();
+    if (path_table_path == NULL)
+        return NULL;
+
+    size_t len = strlen(command);
+    unsigned int hash = hash_bytes(command, len);
+    size_t i = hash & (path_capacity - 1);
+    while (path_table[i].name != NULL) {
+        if (path_table[i].hash == hash && strcmp(path_table[i].name, command) == 0)
+            return path_table[i].path;
+        i = (i + 1) & (path_capacity - 1);
+    }
+
+    char *path_copy = strdup(path_table_path);
     char sub_path[1024];
-    char *dir = strtok(path_copy, ":");
-    while (dir){
+    const char *found = NULL;
+    for (char *dir = strtok(path_copy, ":"); dir && !found; dir = strtok(NULL, ":")) {
         snprintf(sub_path, sizeof(sub_path), "%s/%s", dir, command);
-        if (access(sub_path, X_OK) == 0){
-            free(path_copy);
-            return 1;
-        }    
-        dir = strtok(NULL, ":");
+        if (access(sub_path, X_OK) == 0)
+            found = path_hash_insert(command, len, hash, sub_path);
     }
-    
     free(path_copy);
-    return 0;
+    return found;
+}
+
+/**
+ * @brief Verifica si un comando existe en el PATH del sistema
+ * @param command Nombre del comando a verificar
+ * @return 1 si existe, 0 si no existe
+ */
+char command_exists(const char *command) {
+    // Una ruta explícita no se busca en el PATH
+    if (strchr(command, '/') != NULL)
+        return access(command, X_OK) == 0;
+
+    return command_path(command) != NULL;
 }
 
 /**
@@ -158,15 +325,32 @@ char command_exists(const char *command) {
  * @param args Arreglo de argumentos (incluyendo el comando)
  * @param background Indica si el comando se ejecuta en segundo plano (1) o primer plano (0)
  * 
- * Primero verifica si es un comando built-in, si no, lo ejecuta como proceso externo.
+ * Los built-ins se ejecutan en la shell salvo en segundo plano (ver shell_state);
+ * el resto se ejecuta como proceso externo.
  * Actualiza last_command_status con el estado de salida del comando.
  */
 void run_command(const char *command, char *args[], int background) {
-    // Primero verificar si es un comando built-in
-    if (execute_builtin(args)) {
+    // Los built-ins se ejecutan en la propia shell; en segundo plano, solo
+    // los que trabajan sobre su estado (el resto va a un hijo como un trabajo más)
+    int builtin = find_active_builtin(args[0]);
+    if (builtin >= 0 && (!background || builtin_commands[builtin].shell_state)) {
+        builtin_commands[builtin].func(args);
         return;
     }
     
+    // Vaciar stdout para no mezclar la salida de los built-ins con la del hijo
+    fflush(stdout);
+
+    // Ruta ya resuelta en la tabla del PATH (se busca antes de fork para que quede guardada)
+    const char *path = builtin < 0 && strchr(args[0], '/') == NULL ? command_path(args[0]) : NULL;
+
+    // En modo interactivo la salida de los trabajos en segundo plano se captura
+    int capture[2] = {-1, -1};
+    if (background && interactive && pipe(capture) < 0) {
+        perror("pipe");
+        capture[0] = capture[1] = -1;
+    }
+
     pid_t pid = fork();
     if (pid < 0) {
         perror("Fork failed");
@@ -176,6 +360,26 @@ void run_command(const char *command, char *args[], int background) {
     else if (pid == 0) { /* Child process */
         // Restaura el comportamiento por defecto de SIGINT en el proceso hijo
         signal(SIGINT, SIG_DFL);
+        if (capture[1] >= 0) {
+            // Fuera del grupo del terminal: Ctrl+C en el prompt no lo interrumpe
+            setpgid(0, 0);
+            int null_fd = open("/dev/null", O_RDONLY);
+            if (null_fd >= 0) {
+                dup2(null_fd, STDIN_FILENO);
+                close(null_fd);
+            }
+            dup2(capture[1], STDOUT_FILENO);
+            dup2(capture[1], STDERR_FILENO);
+            close(capture[0]);
+            close(capture[1]);
+        }
+        if (builtin >= 0) {
+            builtin_commands[builtin].func(args);
+            fflush(stdout);
+            exit(last_command_status);
+        }
+        if (path != NULL)
+            execv(path, args);
         execvp(args[0], args);
         perror("Execution failed"); /* If execvp fails */
         exit(1); // Salir con error
@@ -200,23 +404,214 @@ void run_command(const char *command, char *args[], int background) {
             current_child_pid = 0;
             foreground_process_running = 0;
         } else {
+            if (capture[0] >= 0) {
+                close(capture[1]);
+                Job *job = job_start(pid, capture[0], args);
+                printf("[%d] %d\n", job->id, (int)pid);
+            }
             // Para procesos en background, asumimos éxito a menos que sepamos lo contrario
             last_command_status = 0;
         }
     }
 }
 
+/**
+ * @brief Expande y ejecuta el plan de una línea de comando
+ * @param plan Plan de expansión de la línea
+ *
+ * Las asignaciones NOMBRE=valor sin comando se guardan como variables de
+ * la shell. Si preceden a un comando, solo se aplican (exportadas) mientras
+ * dura ese comando. El comando se busca primero entre las funciones, luego
+ * entre los built-ins (ya resuelto al compilar si el nombre es fijo) y por
+ * último en el PATH. Si no existe, se ofrecen sugerencias.
+ */
+void execute_plan(const CommandPlan *plan) {
+    ArgList args = {NULL, 0, 0};
+    expand_failed = 0;
+    plan_expand(plan, &args);
+    if (expand_failed) {
+        last_command_status = 1;
+        arglist_free(&args);
+        return;
+    }
+
+    // Las asignaciones iniciales siempre producen exactamente un argumento
+    int nassign = 0;
+    while (nassign < plan->nwords && (plan->words[nassign].flags & WORD_ASSIGN))
+        nassign++;
+
+    if (nassign == args.argc) {
+        for (int i = 0; i < nassign; i++) {
+            char *eq = strchr(args.argv[i], '=');
+            *eq = '\0';
+            var_set(args.argv[i], eq + 1, -1);
+        }
+        last_command_status = 0;
+        arglist_free(&args);
+        return;
+    }
+
+    // Guardar el estado anterior de las variables asignadas temporalmente
+    char **saved_values = malloc((nassign + 1) * sizeof(char *));
+    int *saved_exported = malloc((nassign + 1) * sizeof(int));
+    for (int i = 0; i < nassign; i++) {
+        char *eq = strchr(args.argv[i], '=');
+        *eq = '\0';
+        const ShellVar *old = var_lookup(args.argv[i]);
+        saved_values[i] = old ? strdup(old->value) : NULL;
+        saved_exported[i] = old ? old->exported : 0;
+        var_set(args.argv[i], eq + 1, 1);
+    }
+
+    char **argv = args.argv + nassign;
+    if (plan->background && vm_function_exists(argv[0])) {
+        // Como ( ... ) &: el cuerpo de una función no es un comando simple
+        fprintf(stderr, "dwimsh: %s: las funciones no pueden ejecutarse en segundo plano\n", argv[0]);
+        last_command_status = 1;
+    } else if (vm_call_function(argv)) {
+        // Función de la shell
+    } else if (plan->builtin >= 0 && !builtin_commands[plan->builtin].disabled && !plan->background) {
+        builtin_commands[plan->builtin].func(argv);
+    } else if (find_active_builtin(argv[0]) >= 0) {
+        run_command(argv[0], argv, plan->background);
+    } else {
+        char *command = argv[0];
+        if (command_exists(command)) {
+            run_command(argv[0], argv, plan->background);
+        } else if (!interactive) {
+            // Un script no puede responder a las sugerencias
+            fprintf(stderr, "dwimsh: %s: orden no encontrada\n", command);
+            last_command_status = 127;
+        } else {
+            suggest_command(command, argv);
+            if (argv[0] == NULL || argv[0] == command) {
+                printf("No entiendo que quiere hacer, pruebe de nuevo.\n");
+                last_command_status = 1; // Marcar como error
+                argv[0] = command;
+            } else {
+                free(command);
+                run_command(argv[0], argv, plan->background);
+            }
+        }
+    }
+
+    for (int i = nassign - 1; i >= 0; i--) {
+        if (saved_values[i] != NULL) {
+            var_set(args.argv[i], saved_values[i], saved_exported[i]);
+            free(saved_values[i]);
+        } else {
+            var_unset(args.argv[i]);
+        }
+    }
+    free(saved_values);
+    free(saved_exported);
+    arglist_free(&args);
+}
+
+/**
+ * @brief Lee un archivo completo en memoria
+ * @param path Ruta del archivo
+ * @return Contenido terminado en '\0' (reservado con malloc) o NULL si hay error
+ */
+static char *read_file(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    size_t len = 0, cap = 4096;
+    char *text = malloc(cap);
+    for (;;) {
+        if (cap - len < 4096) {
+            cap *= 2;
+            text = realloc(text, cap);
+        }
+        ssize_t n = read(fd, text + len, cap - len - 1);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            free(text);
+            close(fd);
+            return NULL;
+        }
+        if (n == 0)
+            break;
+        len += n;
+    }
+    close(fd);
+    text[len] = '\0';
+    return text;
+}
+
+/**
+ * @brief Ejecuta un script (dwimsh archivo args...) o un texto (dwimsh -c texto [nombre args...])
+ * @param argc Número de argumentos de la shell
+ * @param argv Argumentos de la shell
+ * @return Estado de salida del script
+ *
+ * El texto completo se compila una vez y se ejecuta en la máquina virtual.
+ * En este modo no hay prompt ni sugerencias.
+ */
+static int run_script(int argc, char *argv[]) {
+    char *text;
+    int first_param;
+
+    interactive = 0;
+    if (strcmp(argv[1], "-c") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "dwimsh: -c: se requiere un argumento\n");
+            return 2;
+        }
+        text = strdup(argv[2]);
+        first_param = 3;
+    } else {
+        text = read_file(argv[1]);
+        if (text == NULL) {
+            fprintf(stderr, "dwimsh: %s: %s\n", argv[1], strerror(errno));
+            return 127;
+        }
+        first_param = 1;
+    }
+
+    // $0 es el nombre del script (o "dwimsh" con -c si no se indica)
+    char *shell_name = "dwimsh";
+    positional_params.argv = first_param < argc ? argv + first_param : &shell_name;
+    positional_params.argc = first_param < argc ? argc - first_param : 1;
+
+    Program *prog;
+    int result = program_compile(text, &prog);
+    free(text);
+    if (result == 0)
+        fprintf(stderr, "dwimsh: fin de archivo inesperado\n");
+    if (result != 1)
+        return 2;
+
+    vm_execute(prog);
+    program_release(prog);
+    return last_command_status;
+}
+
 /**
  * @brief Función principal de la shell
+ * @param argc Número de argumentos
+ * @param argv Argumentos (un script o -c texto para el modo no interactivo,
+ *             --server [socket] o --client ... para el modo servidor)
  * @return Estado de salida de la shell
  * 
  * Implementa el bucle principal de la shell, leyendo comandos del usuario,
- * procesándolos y ejecutándolos.
+ * procesándolos y ejecutándolos. Si una línea queda incompleta (comillas
+ * sin cerrar, un if sin fi...) se pide la continuación con "> ".
  */
-int main(void) {
+int main(int argc, char *argv[]) {
     char *inputBuffer;
-    int background;
-    char *args[MAX_LINE / +1];
+    char *pending = NULL;
+
+    vars_init(environ);
+    if (argc > 1 && strcmp(argv[1], "--server") == 0)
+        return server_run(argc > 2 ? argv[2] : server_socket_path());
+    if (argc > 1 && strcmp(argv[1], "--client") == 0)
+        return client_run(argc, argv);
+    if (argc > 1)
+        return run_script(argc, argv);
 
     // Configura el manejador de señal para SIGINT
     signal(SIGINT, handle_sigint);
@@ -225,63 +620,53 @@ int main(void) {
 
     printf("Bienvenido a dwimsh - Escrito por Walther Carrasco\n");
     bin_commands();
+    jobs_init();
     
     while (1) { 
-        background = 0;
-        
+        // Avisar de los trabajos terminados antes de mostrar el prompt
+        if (pending == NULL)
+            jobs_notify();
+
         // Usa readline para obtener input con prompt coloreado
-        inputBuffer = readline(get_colored_prompt());
+        inputBuffer = readline(pending ? "> " : get_colored_prompt());
         
         // Si el usuario presiona Ctrl+D, inputBuffer será NULL
         if (inputBuffer == NULL) {
+            if (pending != NULL) {
+                fprintf(stderr, "\ndwimsh: fin de archivo inesperado");
+                free(pending);
+            }
             printf("\nSaliendo de dwimsh...\n");
             break;
         }
-        
-        // Si el comando no está vacío, añadirlo al historial
-        if (*inputBuffer) {
-            add_history(inputBuffer);
-        }
-        
-        // Parsear la línea para obtener los argumentos
-        char *token;
-        int i = 0;
-        token = strtok(inputBuffer, " \t\n");
-        
-        while (token != NULL && i < MAX_LINE/2) {
-            args[i] = token;
-            token = strtok(NULL, " \t\n");
-            i++;
-        }
-        args[i] = NULL;
-        
-        // Verificar si es un comando en background
-        if (i > 0 && strcmp(args[i-1], "&") == 0) {
-            background = 1;
-            args[i-1] = NULL;
+
+        // Unir la continuación con las líneas anteriores
+        if (pending != NULL) {
+            char *joined = malloc(strlen(pending) + strlen(inputBuffer) + 2);
+            sprintf(joined, "%s\n%s", pending, inputBuffer);
+            free(pending);
+            free(inputBuffer);
+            inputBuffer = joined;
+            pending = NULL;
         }
         
-        if (args[0] == NULL) {
-            free(inputBuffer);
+        // Obtener el programa ya compilado (desde la caché si se repite)
+        int result;
+        Program *prog = program_cache_lookup(inputBuffer, &result);
+        if (result == 0) {
+            pending = inputBuffer;
             continue;
         }
 
-        if (execute_builtin(args)){
-            free(inputBuffer);
-            continue;
+        // Si el comando no está vacío, añadirlo al historial
+        if (*inputBuffer) {
+            add_history(inputBuffer);
         }
-
-        if (!command_exists(args[0])){
-            suggest_command(args[0], args);
-            if (args[0] == NULL){
-                printf("No entiendo que quiere hacer, pruebe de nuevo.\n");
-                last_command_status = 1; // Marcar como error
-                free(inputBuffer);
-                continue;
-            }
-            run_command(args[0], args, background);
+        
+        if (prog == NULL) {
+            last_command_status = 1; // Error de sintaxis
         } else {
-            run_command(args[0], args, background);
+            vm_execute(prog);
         }
         
         free(inputBuffer);  // Importante liberar la memoria asignada por readline
@@ -17,7 +17,26 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <string.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <limits.h>
+#include <time.h>
+#include <ctype.h>
+#include <locale.h>
+#include <langinfo.h>
+#include <wchar.h>
+#include <wctype.h>
 #include <math.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <fnmatch.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/syscall.h>
 #include <dirent.h>
 #include <signal.h>
 #include <readline/readline.h>
@@ -43,6 +62,8 @@ extern pid_t current_child_pid; /**< PID del proceso hijo actualmente en ejecuci
 extern int foreground_process_running; /**< Indica si hay un proceso en primer plano */
 extern int last_command_status; /**< Estado de salida del último comando ejecutado */
 extern volatile sig_atomic_t suggestion_interrupted; /**< Indica si se interrumpió una sugerencia */
+extern int interactive;         /**< 0 al ejecutar un script o con -c (sin sugerencias ni mensajes) */
+extern int subshell;            /**< 1 en los hijos de ( ... ) y $( ... ) */
 
 // Funciones principales
 /**
@@ -62,6 +83,12 @@ void handle_sigint(int sig);
  */
 void bin_commands();
 
+/**
+ * @brief Carga los comandos ejecutables de un directorio
+ * @param path Directorio a recorrer
+ */
+void load_commands(const char *path);
+
 /**
  * @brief Verifica si un comando existe en el PATH
  * @param command Nombre del comando a verificar
@@ -69,6 +96,18 @@ void bin_commands();
  */
 char command_exists(const char *command);
 
+/**
+ * @brief Busca la ruta completa de un comando en el PATH (con caché)
+ * @param command Nombre del comando (sin '/')
+ * @return Ruta del ejecutable o NULL si no está en el PATH
+ */
+const char *command_path(const char *command);
+
+/**
+ * @brief Guarda en la caché de rutas todos los ejecutables del PATH
+ */
+void path_hash_fill(void);
+
 /**
  * @brief Ejecuta un comando externo o built-in
  * @param command Nombre del comando a ejecutar
@@ -77,4 +116,12 @@ char command_exists(const char *command);
  */
 void run_command(const char *command, char *args[], int background);
 
+struct CommandPlan;
+
+/**
+ * @brief Expande y ejecuta el plan de una línea de comando
+ * @param plan Plan de expansión de la línea (ver expand.h)
+ */
+void execute_plan(const struct CommandPlan *plan);
+
 #endif // SHELL_H 
\ No newline at end of file
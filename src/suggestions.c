@@ -163,16 +163,20 @@ void suggest_command(const char *command, char *args[]) {
     char response[16]; 
 
     while (suggestion_index < count && !suggestion_interrupted) {
-        strcpy(full_command_with_args, suggestions[suggestion_index]);
-        for (int i = 1; args[i] != NULL; i++) {
-            strcat(full_command_with_args, " ");
-            strcat(full_command_with_args, args[i]);
+        // Construir la línea sugerida sin desbordar el búfer (los glob pueden producir muchos argumentos)
+        int len = snprintf(full_command_with_args, sizeof(full_command_with_args), "%s", suggestions[suggestion_index]);
+        for (int i = 1; args[i] != NULL && len < (int)sizeof(full_command_with_args); i++) {
+            len += snprintf(full_command_with_args + len, sizeof(full_command_with_args) - len, " %s", args[i]);
         }
         
         printf("¿Quieres decir \"%s\"? [s/n] ", full_command_with_args);
         fflush(stdout);
         
         if (fgets(response, sizeof(response), stdin) == NULL || suggestion_interrupted) {
+            // Ctrl+D equivale a rechazar todas las sugerencias
+            if (!suggestion_interrupted)
+                printf("\n");
+            suggestion_index = count;
             break;
         }
 
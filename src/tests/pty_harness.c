@@ -0,0 +1,867 @@
+/**
+ * @file pty_harness.c
+ * @brief Pruebas y benchmarks de extremo a extremo de dwimsh sobre un pseudoterminal
+ *
+ * Lanza dwimsh con forkpty y le escribe como lo haría una persona: tecla a
+ * tecla y con Enter. La salida se limpia de secuencias de escape y de \r
+ * antes de compararla, así que las comprobaciones no dependen de los
+ * colores del prompt.
+ *
+ * Uso:
+ *   pty_harness --test [ruta a dwimsh]    comprueba la salida de cada caso
+ *   pty_harness --bench [ruta a dwimsh]   mide latencias tecla→eco, Enter→ejecución
+ *                                         y Enter→prompt, y tiempos de scripts (también
+ *                                         con bash y dash si están en el PATH)
+ *
+ * Ambos modos escriben una línea JSON por resultado en stdout. En modo
+ * --test el código de salida es 1 si falla algún caso.
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#ifdef __APPLE__
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+
+// Texto que identifica el prompt principal
+#define PROMPT "dwimsh> "
+
+// Espera máxima por defecto de cada comprobación (milisegundos)
+#define DEFAULT_TIMEOUT 5000
+
+// Muestras de cada benchmark de latencia
+#define BENCH_SAMPLES 300
+
+// Archivos del directorio del benchmark de glob
+#define GLOB_FILES 100000
+
+/**
+ * @brief Sesión interactiva de dwimsh sobre un pseudoterminal
+ */
+typedef struct Session {
+    /** PID de la shell */
+    pid_t pid;
+    /** Extremo maestro del pseudoterminal */
+    int fd;
+    /** Salida acumulada, sin secuencias de escape ni \r */
+    char *out;
+    /** Bytes en out */
+    size_t len;
+    /** Capacidad de out */
+    size_t cap;
+    /** Estado del filtro de escapes (0 texto, 1 tras ESC, 2 dentro de CSI) */
+    int esc;
+} Session;
+
+// Ruta del ejecutable bajo prueba
+static const char *shell_path = "./dwimsh";
+
+// Casos fallidos en modo --test
+static int failures = 0;
+
+/**
+ * @brief Tiempo monotónico actual en microsegundos
+ * @return Microsegundos
+ */
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/**
+ * @brief Añade bytes leídos del terminal a la salida, quitando escapes y \r
+ * @param s Sesión
+ * @param data Bytes leídos
+ * @param n Número de bytes
+ */
+static void session_append(Session *s, const char *data, size_t n) {
+    if (s->len + n + 1 > s->cap) {
+        while (s->len + n + 1 > s->cap)
+            s->cap = s->cap ? s->cap * 2 : 65536;
+        s->out = realloc(s->out, s->cap);
+    }
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = data[i];
+        if (s->esc == 1) {
+            s->esc = c == '[' ? 2 : 0;
+        } else if (s->esc == 2) {
+            if (c >= 0x40 && c <= 0x7e)
+                s->esc = 0;
+        } else if (c == 0x1b) {
+            s->esc = 1;
+        } else if (c != '\r' && c != '\001' && c != '\002' && c != '\a') {
+            s->out[s->len++] = c;
+        }
+    }
+    s->out[s->len] = '\0';
+}
+
+/**
+ * @brief Lanza dwimsh en un pseudoterminal nuevo
+ * @param s Sesión a inicializar
+ * @return 0 si se lanzó, -1 si hubo un error
+ */
+static int session_start(Session *s) {
+    struct winsize ws = {.ws_row = 50, .ws_col = 250};
+
+    memset(s, 0, sizeof(*s));
+    s->pid = forkpty(&s->fd, NULL, NULL, &ws);
+    if (s->pid < 0) {
+        perror("forkpty");
+        return -1;
+    }
+    if (s->pid == 0) {
+        // Entorno estable: sin inputrc del usuario ni terminal con capacidades
+        setenv("TERM", "dumb", 1);
+        setenv("INPUTRC", "/dev/null", 1);
+        setenv("LC_ALL", "C", 1);
+        execl(shell_path, "dwimsh", (char *)NULL);
+        perror(shell_path);
+        _exit(127);
+    }
+    return 0;
+}
+
+/**
+ * @brief Lee lo que haya disponible en el terminal
+ * @param s Sesión
+ * @param timeout Milisegundos máximos de espera
+ * @return 1 si se leyó algo, 0 si se agotó el tiempo, -1 si la shell cerró el terminal
+ */
+static int session_read(Session *s, int timeout) {
+    struct pollfd pfd = {.fd = s->fd, .events = POLLIN};
+    char buf[65536];
+
+    int r = poll(&pfd, 1, timeout);
+    if (r <= 0)
+        return 0;
+    ssize_t n = read(s->fd, buf, sizeof(buf));
+    if (n <= 0)
+        return -1;
+    session_append(s, buf, n);
+    return 1;
+}
+
+/**
+ * @brief Espera a que aparezca un texto en la salida
+ * @param s Sesión
+ * @param from Posición de la salida desde la que buscar
+ * @param needle Texto esperado
+ * @param timeout Milisegundos máximos de espera
+ * @return Posición justo después del texto, o -1 si no apareció
+ */
+static long session_wait(Session *s, size_t from, const char *needle, int timeout) {
+    double deadline = now_us() + timeout * 1000.0;
+    size_t nlen = strlen(needle);
+
+    for (;;) {
+        if (s->len >= from + nlen) {
+            char *hit = memmem(s->out + from, s->len - from, needle, nlen);
+            if (hit != NULL)
+                return hit - s->out + nlen;
+        }
+        double left = deadline - now_us();
+        if (left <= 0)
+            return -1;
+        if (session_read(s, (int)(left / 1000) + 1) < 0)
+            return -1;
+    }
+}
+
+/**
+ * @brief Escribe texto en el terminal como si se tecleara
+ * @param s Sesión
+ * @param text Texto a escribir
+ */
+static void session_send(Session *s, const char *text) {
+    size_t len = strlen(text);
+    while (len > 0) {
+        ssize_t n = write(s->fd, text, len);
+        if (n <= 0)
+            return;
+        text += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief Cierra la sesión y recoge el estado de salida de la shell
+ * @param s Sesión
+ * @return Estado de salida, o -1 si terminó por una señal
+ */
+static int session_close(Session *s) {
+    int status = 0;
+
+    // Dejar que la shell termine sola; si no, forzarla
+    for (int i = 0; i < 200 && waitpid(s->pid, &status, WNOHANG) == 0; i++) {
+        if (session_read(s, 10) < 0)
+            usleep(10000);
+    }
+    if (waitpid(s->pid, &status, WNOHANG) == 0) {
+        kill(s->pid, SIGKILL);
+        waitpid(s->pid, &status, 0);
+    }
+    close(s->fd);
+    free(s->out);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/**
+ * @brief Escribe una cadena como literal JSON
+ * @param text Cadena
+ * @param max Bytes máximos a escribir
+ */
+static void json_string(const char *text, size_t max) {
+    putchar('"');
+    for (size_t i = 0; text[i] && i < max; i++) {
+        unsigned char c = text[i];
+        if (c == '"' || c == '\\')
+            printf("\\%c", c);
+        else if (c == '\n')
+            printf("\\n");
+        else if (c < 0x20)
+            printf("\\u%04x", c);
+        else
+            putchar(c);
+    }
+    putchar('"');
+}
+
+/**
+ * @brief Informa del resultado de un caso de prueba
+ * @param name Nombre del caso
+ * @param ok 1 si pasó
+ * @param ms Milisegundos que tardó
+ * @param output Salida observada (se incluye solo si falló)
+ */
+static void report_test(const char *name, int ok, double ms, const char *output) {
+    printf("{\"test\": \"%s\", \"ok\": %s, \"ms\": %.2f", name, ok ? "true" : "false", ms);
+    if (!ok && output != NULL) {
+        printf(", \"output\": ");
+        json_string(output, 400);
+    }
+    printf("}\n");
+    fflush(stdout);
+    if (!ok)
+        failures++;
+}
+
+/**
+ * @brief Ejecuta una entrada en la sesión y comprueba su salida
+ * @param s Sesión (con el prompt ya mostrado)
+ * @param name Nombre del caso
+ * @param input Texto a teclear (incluye los Enter)
+ * @param expect Texto que debe aparecer antes del siguiente prompt
+ */
+static void check(Session *s, const char *name, const char *input, const char *expect) {
+    size_t mark = s->len;
+    double start = now_us();
+
+    session_send(s, input);
+    long end = session_wait(s, mark, "\n" PROMPT, DEFAULT_TIMEOUT);
+    double ms = (now_us() - start) / 1000;
+    int ok = end >= 0 && memmem(s->out + mark, end - mark, expect, strlen(expect)) != NULL;
+    report_test(name, ok, ms, s->out + mark);
+}
+
+/**
+ * @brief Ejecuta dwimsh con unos argumentos y recoge su salida
+ * @param argv Argumentos (argv[0] es el nombre del programa)
+ * @param out Búfer para la salida estándar (termina en '\0')
+ * @param size Tamaño del búfer
+ * @param err_fd Descriptor para la salida de error (-1 para descartarla)
+ * @return Estado de salida, o -1 si terminó por una señal
+ */
+static int run_shell(char *const argv[], char *out, size_t size, int err_fd) {
+    int fds[2];
+    size_t len = 0;
+
+    out[0] = '\0';
+    if (pipe(fds) < 0) {
+        perror("pipe");
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(fds[1], STDOUT_FILENO);
+        dup2(err_fd >= 0 ? err_fd : null_fd, STDERR_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        setenv("LC_ALL", "C", 1);
+        execv(shell_path, argv);
+        _exit(127);
+    }
+    close(fds[1]);
+    ssize_t n;
+    while ((n = read(fds[0], out + len, size - 1 - len)) > 0)
+        len += n;
+    out[len] = '\0';
+    close(fds[0]);
+
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/**
+ * @brief Ejecuta dwimsh con unos argumentos y comprueba su salida y su estado
+ * @param name Nombre del caso
+ * @param argv Argumentos (argv[0] es el nombre del programa)
+ * @param expect Salida exacta esperada
+ * @param expect_status Estado de salida esperado
+ */
+static void check_command(const char *name, char *const argv[], const char *expect, int expect_status) {
+    char out[4096];
+    double start = now_us();
+    int status = run_shell(argv, out, sizeof(out), -1);
+    report_test(name, status == expect_status && strcmp(out, expect) == 0, (now_us() - start) / 1000, out);
+}
+
+/**
+ * @brief Ejecuta dwimsh -c texto y comprueba su salida y su estado
+ * @param name Nombre del caso
+ * @param script Texto del script
+ * @param expect Salida exacta esperada
+ * @param expect_status Estado de salida esperado
+ */
+static void check_script(const char *name, const char *script, const char *expect, int expect_status) {
+    char *argv[] = {"dwimsh", "-c", (char *)script, NULL};
+    check_command(name, argv, expect, expect_status);
+}
+
+// Built-ins con un binario equivalente en coreutils
+#define COREUTILS_BUILTINS "true false test [ printf basename dirname sleep"
+
+/**
+ * @brief Lee lo escrito en un archivo temporal y lo vacía
+ * @param fd Descriptor del archivo
+ * @param out Búfer para el contenido (termina en '\0')
+ * @param size Tamaño del búfer
+ */
+static void read_and_truncate(int fd, char *out, size_t size) {
+    ssize_t n = pread(fd, out, size - 1, 0);
+    out[n > 0 ? n : 0] = '\0';
+    if (ftruncate(fd, 0) < 0)
+        perror("ftruncate");
+    lseek(fd, 0, SEEK_SET);
+}
+
+/**
+ * @brief Ejecuta un script con los built-ins y con los binarios de coreutils (enable -n) y compara
+ * @param name Nombre del caso
+ * @param script Texto del script
+ *
+ * Deben coincidir la salida, la salida de error y el estado de salida,
+ * tanto en el locale C como en C.UTF-8 (donde los mensajes citan con ‘ y ’).
+ */
+static void check_coreutils(const char *name, const char *script) {
+    static const char *locales[] = {"C", "C.UTF-8"};
+    char scripts[2][4096], out[2][16384], err[2][16384];
+    int status[2];
+    int ok = 1;
+    double start = now_us();
+
+    FILE *tmp = tmpfile();
+    if (tmp == NULL) {
+        perror("tmpfile");
+        return;
+    }
+    for (int l = 0; l < 2 && ok; l++) {
+        snprintf(scripts[0], sizeof(scripts[0]), "export LC_ALL=%s; %s", locales[l], script);
+        snprintf(scripts[1], sizeof(scripts[1]), "export LC_ALL=%s; enable -n " COREUTILS_BUILTINS "; %s",
+                 locales[l], script);
+        for (int i = 0; i < 2; i++) {
+            char *argv[] = {"dwimsh", "-c", scripts[i], NULL};
+            status[i] = run_shell(argv, out[i], sizeof(out[i]), fileno(tmp));
+            read_and_truncate(fileno(tmp), err[i], sizeof(err[i]));
+        }
+        ok = status[0] == status[1] && strcmp(out[0], out[1]) == 0 && strcmp(err[0], err[1]) == 0;
+    }
+    fclose(tmp);
+
+    report_test(name, ok, (now_us() - start) / 1000, out[0]);
+}
+
+/**
+ * @brief Casos del modo servidor: lanza dwimsh --server y le pide comandos con --client
+ */
+static void run_server_tests(void) {
+    char socket_path[108];
+    snprintf(socket_path, sizeof(socket_path), "/tmp/dwimsh-test-%d.sock", (int)getpid());
+
+    pid_t server = fork();
+    if (server == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDERR_FILENO);
+        execl(shell_path, "dwimsh", "--server", socket_path, (char *)NULL);
+        _exit(127);
+    }
+    // Esperar a que aparezca el socket
+    for (int i = 0; i < 500 && access(socket_path, F_OK) != 0; i++)
+        usleep(10000);
+    usleep(20000);
+
+    char *sock = socket_path;
+    check_command("servidor", (char *[]){"dwimsh", "--client", "-s", sock, "echo hola", NULL}, "hola\n", 0);
+    check_command("servidor-captura", (char *[]){"dwimsh", "--client", "-s", sock, "-o",
+                  "for i in 1 2; do echo $i; done; exit 6", NULL}, "1\n2\n", 6);
+    check_command("servidor-entorno", (char *[]){"dwimsh", "--client", "-s", sock, "-e", "V=42",
+                  "echo", "v=$V", NULL}, "v=42\n", 0);
+    check_command("servidor-sintaxis", (char *[]){"dwimsh", "--client", "-s", sock, "if true; then", NULL}, "", 2);
+    check_command("servidor-externo", (char *[]){"dwimsh", "--client", "-s", sock, "-o", "/bin/echo externo", NULL},
+                  "externo\n", 0);
+
+    // El directorio de trabajo del cliente se aplica al comando
+    char cwd[4096];
+    if (getcwd(cwd, sizeof(cwd)) != NULL && chdir("/") == 0) {
+        check_command("servidor-directorio", (char *[]){"dwimsh", "--client", "-s", sock, "pwd", NULL}, "/\n", 0);
+        if (chdir(cwd) < 0)
+            perror(cwd);
+    }
+
+    kill(server, SIGTERM);
+    int status;
+    waitpid(server, &status, 0);
+    report_test("servidor-fin", WIFEXITED(status) && WEXITSTATUS(status) == 0 && access(socket_path, F_OK) != 0,
+                0, NULL);
+}
+
+/**
+ * @brief Casos de prueba funcionales (--test)
+ * @return 0 si todos pasaron, 1 si alguno falló
+ */
+static int run_tests(void) {
+    Session s;
+
+    if (session_start(&s) < 0)
+        return 1;
+    if (session_wait(&s, 0, PROMPT, DEFAULT_TIMEOUT) < 0) {
+        report_test("arranque", 0, 0, s.out);
+        session_close(&s);
+        return 1;
+    }
+    report_test("arranque", 1, 0, NULL);
+
+    check(&s, "echo", "echo hola mundo\n", "\nhola mundo\n");
+    check(&s, "estado", "false; echo $?\n", "\n1\n");
+    check(&s, "externo", "/bin/echo externo\n", "\nexterno\n");
+    check(&s, "variables", "x=21; echo $((x * 2))\n", "\n42\n");
+    check(&s, "comillas", "v='a  b'; echo \"[$v]\"\n", "\n[a  b]\n");
+    check(&s, "for", "for i in a b c; do echo -$i-; done\n", "\n-a-\n-b-\n-c-\n");
+    check(&s, "while", "i=0; while [ $i -lt 3 ]; do i=$((i+1)); done; echo i=$i\n", "\ni=3\n");
+    check(&s, "funciones", "sq() { echo $(( $1 * $1 )); }; sq 9\n", "\n81\n");
+    check(&s, "sustitucion", "echo x$(echo y)z\n", "\nxyz\n");
+    check(&s, "continuacion", "if true; then\necho cont\nfi\n", "\ncont\n");
+    check(&s, "subshell-exit", "(exit 3); echo $?\n", "echo $?\n3\n");
+    check(&s, "sustitucion-exit", "x=$(echo hi; exit 2); echo \"[$x]\"\n", "\n[hi]\n");
+    check(&s, "export-comillas", "export Q='x\"$y'; export\n", "\nexport Q=\"x\\\"\\$y\"\n");
+    check(&s, "funcion-fondo", "g() { sleep 5; }; g & echo $?\n", "segundo plano\n1\n");
+
+    // Sugerencia aceptada: "ehco" es un anagrama de echo
+    size_t mark = s.len;
+    double start = now_us();
+    session_send(&s, "ehco sugerido\n");
+    int ok = session_wait(&s, mark, "[s/n] ", DEFAULT_TIMEOUT) >= 0;
+    if (ok) {
+        session_send(&s, "s\n");
+        long end = session_wait(&s, mark, "\n" PROMPT, DEFAULT_TIMEOUT);
+        ok = end >= 0 && memmem(s.out + mark, end - mark, "\nsugerido\n", 10) != NULL;
+    }
+    report_test("sugerencias", ok, (now_us() - start) / 1000, s.out + mark);
+
+    // Ctrl+D en la pregunta rechaza las sugerencias sin terminar la shell
+    mark = s.len;
+    start = now_us();
+    session_send(&s, "lsx -l\n");
+    ok = session_wait(&s, mark, "[s/n] ", DEFAULT_TIMEOUT) >= 0;
+    if (ok) {
+        session_send(&s, "\004");
+        ok = session_wait(&s, mark, "pruebe de nuevo.\n" PROMPT, DEFAULT_TIMEOUT) >= 0;
+    }
+    report_test("sugerencias-eof", ok, (now_us() - start) / 1000, s.out + mark);
+    check(&s, "tras-sugerencias-eof", "echo vivo\n", "\nvivo\n");
+
+    // Salida de un trabajo en segundo plano capturada en su búfer
+    check(&s, "trabajo", "seq 1 100 &\n", "[");
+    check(&s, "jobstream", "jobstream\n", "\n100\n");
+    check(&s, "jobtail", "jobtail -n 2\n", "\n99\n100\n");
+
+    // Un built-in en segundo plano no bloquea el prompt: se ejecuta como un trabajo
+    mark = s.len;
+    start = now_us();
+    session_send(&s, "sleep 1 &\n");
+    ok = session_wait(&s, mark, "\n" PROMPT, 500) >= 0;
+    report_test("builtin-fondo", ok, (now_us() - start) / 1000, s.out + mark);
+    check(&s, "builtin-fondo-jobs", "jobs\n", "sleep 1\n");
+
+    // Ctrl+C detiene un bucle infinito y la shell sigue respondiendo
+    mark = s.len;
+    start = now_us();
+    session_send(&s, "while true; do :; done\n");
+    usleep(200000);
+    session_send(&s, "\003");
+    ok = session_wait(&s, mark, "\n" PROMPT, DEFAULT_TIMEOUT) >= 0;
+    report_test("ctrl-c", ok, (now_us() - start) / 1000, s.out + mark);
+    check(&s, "tras-ctrl-c", "echo vivo\n", "\nvivo\n");
+
+    // exit con código
+    session_send(&s, "exit 3\n");
+    int status = session_close(&s);
+    report_test("exit", status == 3, 0, NULL);
+
+    check_script("script", "for i in 1 2; do echo $i; done", "1\n2\n", 0);
+    check_script("script-funcion", "f() { return 4; }; f; echo $?", "4\n", 0);
+    check_script("script-exit", "echo a; exit 5; echo b", "a\n", 5);
+    check_script("script-sintaxis", "if true; then", "", 2);
+    check_script("script-no-encontrada", "no_existe_xyz", "", 127);
+
+    // Los built-ins de coreutils se comportan igual que los binarios
+    check_coreutils("coreutils-printf",
+                    "printf '%s-%d|%5.2f|%x|%o|%c|%%\\n' ab 42 3.14159 255 8 xyz; "
+                    "printf '%b|%q\\n' 'a\\tb' 'a b'; printf '%05d|%-5s|%+d|%e|%g\\n' 42 ab 7 1234.5 0.0001; "
+                    "printf '%s\\n' a b c; printf '\\x41\\101\\n'; "
+                    "printf '%d\\n' abc; echo $?; printf '%d\\n' 12abc; echo $?; printf; echo $?; "
+                    "printf '%d' \"it's\" 'a\\b' 'a\tb' \"$(printf '\\303\\251')\"; echo $?; printf x y; echo $?");
+    check_coreutils("coreutils-test",
+                    "test 1 -lt 2; echo $?; test abc; echo $?; test; echo $?; test -n ''; echo $?; "
+                    "test -z ''; echo $?; test -d /; echo $?; test -f /; echo $?; "
+                    "test 1 -eq x; echo $?; test a b; echo $?");
+    check_coreutils("coreutils-corchete",
+                    "[ a = a ]; echo $?; [ a != a ]; echo $?; [ 3 -ge 3 ]; echo $?; [ ! -e /no/existe ]; echo $?; "
+                    "[ a = a -a b = c ]; echo $?; [ a = a -o b = c ]; echo $?; [ \\( a = a \\) ]; echo $?; "
+                    "[ a; echo $?; [ 1 -lt ]; echo $?");
+    check_coreutils("coreutils-basename",
+                    "basename /a/b/c.txt .txt; basename /a/b/; basename /; basename ''; basename -a /x/y /z; "
+                    "basename -s .c a.c b.c; basename; echo $?; basename -q x; echo $?");
+    check_coreutils("coreutils-dirname",
+                    "dirname /a/b/c; dirname a; dirname /; dirname //a//b//; dirname a/b c/d; dirname; echo $?");
+    check_coreutils("coreutils-sleep",
+                    "sleep 0; echo $?; sleep 0.01s; echo $?; sleep 0 0.01; echo $?; sleep -1; echo $?; "
+                    "sleep --x; echo $?; sleep x; echo $?; sleep; echo $?; sleep -- -1; echo $?; sleep --; echo $?");
+    check_coreutils("coreutils-true-false", "true; echo $?; false; echo $?; true x; echo $?; false x; echo $?");
+
+    // Opciones: "--", nombres largos y --help/--version (la salida con -z va al final: se compara hasta el '\0')
+    check_coreutils("coreutils-opciones-printf",
+                    "printf -- '%s\\n' x; printf --; echo $?; printf -- --; printf --help; echo $?; "
+                    "printf --version; echo $?; printf --help x; echo $?; "
+                    "printf '\\u00e9|\\U0001F600|%b\\n' '\\u00e9'; printf 'a\\u00'; echo $?; printf 'a\\uD800'; echo $?; "
+                    "printf '%5q'; echo $?");
+    check_coreutils("coreutils-opciones-test",
+                    "[ --help; echo $?; [ --version; echo $?; [ --help ]; echo $?; test --help; echo $?; "
+                    "test \\( \\( a \\) \\); echo $?; test a -a b -a; echo $?; test \\( a b c d e f; echo $?; "
+                    "test -l abc -eq 3; echo $?; test 99999999999999999999 -gt 9; echo $?; "
+                    "test ' 12 ' -eq +12; echo $?; test a -nt -l b; echo $?; test a = -l a; echo $?");
+    check_coreutils("coreutils-opciones-basename",
+                    "basename --suffix=.c a.c b.c; basename --suf .c a.c; basename --multiple a/b c/d; "
+                    "basename --help; echo $?; basename --version; echo $?; basename --m=1 a; echo $?; "
+                    "basename --suffix; echo $?; basename --x; echo $?; basename -q --help; echo $?; "
+                    "basename -- -a; basename --zero a");
+    check_coreutils("coreutils-opciones-dirname",
+                    "dirname --help; echo $?; dirname --version; echo $?; dirname --=x; echo $?; "
+                    "dirname --ze=1 a; echo $?; dirname a -- -z; dirname -zq a; echo $?; dirname a/b --zero -z");
+    check_coreutils("coreutils-opciones-sleep",
+                    "sleep --help; echo $?; sleep --he; echo $?; sleep 0 --v; echo $?; sleep --help=1; echo $?; "
+                    "sleep -- --help; echo $?; sleep 0 -x --help; echo $?");
+    check_coreutils("coreutils-opciones-true-false",
+                    "true --help; echo $?; true --version; echo $?; false --help; echo $?; false --version; echo $?; "
+                    "true --help x; echo $?; true --he; echo $?; false --help x; echo $?; : --help; echo $?");
+
+    run_server_tests();
+
+    fprintf(stderr, "pty_harness: %d caso(s) fallido(s)\n", failures);
+    return failures > 0;
+}
+
+/**
+ * @brief Compara dos double para qsort
+ */
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief Emite los percentiles de una serie de latencias como una línea JSON
+ * @param name Nombre del benchmark
+ * @param samples Latencias en microsegundos (se ordenan)
+ * @param n Número de muestras
+ */
+static void report_latency(const char *name, double *samples, int n) {
+    if (n == 0) {
+        printf("{\"benchmark\": \"%s\", \"samples\": 0}\n", name);
+        return;
+    }
+    qsort(samples, n, sizeof(double), compare_double);
+    printf("{\"benchmark\": \"%s\", \"samples\": %d, \"p50_us\": %.1f, \"p90_us\": %.1f, "
+           "\"p99_us\": %.1f, \"max_us\": %.1f}\n",
+           name, n, samples[n / 2], samples[n * 90 / 100], samples[n * 99 / 100], samples[n - 1]);
+    fflush(stdout);
+}
+
+/**
+ * @brief Mide la latencia de eco de cada tecla
+ * @param s Sesión con el prompt mostrado
+ * @param samples Latencias medidas (microsegundos)
+ * @param n Número de teclas
+ * @return Muestras obtenidas
+ */
+static int bench_keystrokes(Session *s, double *samples, int n) {
+    int got = 0;
+    session_send(s, "echo ");
+    session_wait(s, s->len, "echo ", DEFAULT_TIMEOUT);
+    for (int i = 0; i < n; i++) {
+        // Líneas cortas: se ejecutan cada 40 teclas
+        if (i > 0 && i % 40 == 0) {
+            size_t mark = s->len;
+            session_send(s, "\necho ");
+            session_wait(s, mark, PROMPT "echo ", DEFAULT_TIMEOUT);
+        }
+        size_t mark = s->len;
+        double start = now_us();
+        session_send(s, "k");
+        if (session_wait(s, mark, "k", DEFAULT_TIMEOUT) < 0)
+            break;
+        samples[got++] = now_us() - start;
+    }
+    size_t mark = s->len;
+    session_send(s, "\n");
+    session_wait(s, mark, PROMPT, DEFAULT_TIMEOUT);
+    return got;
+}
+
+/**
+ * @brief Mide Enter→ejecución (aparece la salida) y Enter→prompt
+ * @param s Sesión con el prompt mostrado
+ * @param command Comando que imprime su argumento ("echo" o "/bin/echo")
+ * @param exec_name Nombre del resultado Enter→ejecución
+ * @param prompt_name Nombre del resultado Enter→prompt
+ */
+static void bench_enter(Session *s, const char *command, const char *exec_name, const char *prompt_name) {
+    double exec_us[BENCH_SAMPLES], prompt_us[BENCH_SAMPLES];
+    int got = 0;
+    char line[128], marker[64];
+
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        snprintf(marker, sizeof(marker), "\nMARK%d\n", i);
+        snprintf(line, sizeof(line), "%s MARK%d", command, i);
+
+        // Teclear la línea completa antes de empezar a medir
+        size_t mark = s->len;
+        session_send(s, line);
+        if (session_wait(s, mark, line, DEFAULT_TIMEOUT) < 0)
+            break;
+
+        mark = s->len;
+        double start = now_us();
+        session_send(s, "\n");
+        if (session_wait(s, mark, marker, DEFAULT_TIMEOUT) < 0)
+            break;
+        exec_us[got] = now_us() - start;
+        if (session_wait(s, mark, "\n" PROMPT, DEFAULT_TIMEOUT) < 0)
+            break;
+        prompt_us[got] = now_us() - start;
+        got++;
+    }
+    report_latency(exec_name, exec_us, got);
+    report_latency(prompt_name, prompt_us, got);
+}
+
+/**
+ * @brief Mide el eco de teclas mientras un trabajo en segundo plano escribe sin parar
+ * @param s Sesión con el prompt mostrado
+ *
+ * También informa del caudal aproximado de captura del trabajo.
+ */
+static void bench_keystrokes_under_load(Session *s) {
+    double samples[BENCH_SAMPLES];
+    const double bytes = 512.0 * 1024 * 1024;
+    char line[128];
+
+    size_t mark = s->len;
+    double start = now_us();
+    snprintf(line, sizeof(line), "head -c %.0f /dev/zero &\n", bytes);
+    session_send(s, line);
+    session_wait(s, mark, "\n" PROMPT, DEFAULT_TIMEOUT);
+
+    int got = bench_keystrokes(s, samples, BENCH_SAMPLES);
+    report_latency("keystroke_echo_under_load", samples, got);
+
+    // Esperar a que termine preguntando a jobs
+    for (int i = 0; i < 600; i++) {
+        mark = s->len;
+        session_send(s, "jobs\n");
+        long end = session_wait(s, mark, "\n" PROMPT, DEFAULT_TIMEOUT);
+        if (end >= 0 && memmem(s->out + mark, end - mark, "Hecho", 5) != NULL)
+            break;
+        usleep(50000);
+    }
+    double seconds = (now_us() - start) / 1e6;
+    printf("{\"benchmark\": \"job_capture\", \"bytes\": %.0f, \"seconds\": %.3f, \"mb_per_s\": %.1f}\n",
+           bytes, seconds, bytes / seconds / (1024 * 1024));
+    fflush(stdout);
+}
+
+// Shells con las que se comparan los scripts, si están en el PATH
+static const char *compare_shells[] = {"bash", "dash"};
+
+/**
+ * @brief Busca un ejecutable en el PATH
+ * @param name Nombre del ejecutable
+ * @param path Búfer para la ruta encontrada
+ * @param size Tamaño del búfer
+ * @return 1 si se encontró, 0 si no
+ */
+static int find_in_path(const char *name, char *path, size_t size) {
+    const char *dirs = getenv("PATH");
+    if (dirs == NULL)
+        return 0;
+    while (*dirs) {
+        size_t len = strcspn(dirs, ":");
+        snprintf(path, size, "%.*s/%s", (int)len, len ? dirs : ".", name);
+        if (access(path, X_OK) == 0)
+            return 1;
+        dirs += len + (dirs[len] == ':');
+    }
+    return 0;
+}
+
+/**
+ * @brief Mide el tiempo de un script ejecutado con una shell -c
+ * @param name Nombre del benchmark
+ * @param shell Nombre de la shell (para el JSON y su argv[0])
+ * @param path Ruta de la shell
+ * @param script Texto del script
+ */
+static void bench_shell(const char *name, const char *shell, const char *path, const char *script) {
+    double start = now_us();
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        execl(path, shell, "-c", script, (char *)NULL);
+        _exit(127);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    printf("{\"benchmark\": \"%s\", \"shell\": \"%s\", \"seconds\": %.3f, \"status\": %d}\n",
+           name, shell, (now_us() - start) / 1e6, WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+    fflush(stdout);
+}
+
+/**
+ * @brief Mide el tiempo de un script con dwimsh -c y con las shells de compare_shells
+ * @param name Nombre del benchmark
+ * @param script Texto del script (sintaxis POSIX, para que lo entiendan todas)
+ */
+static void bench_script(const char *name, const char *script) {
+    char path[4096];
+    bench_shell(name, "dwimsh", shell_path, script);
+    for (size_t i = 0; i < sizeof(compare_shells) / sizeof(compare_shells[0]); i++) {
+        if (find_in_path(compare_shells[i], path, sizeof(path)))
+            bench_shell(name, compare_shells[i], path, script);
+    }
+}
+
+/**
+ * @brief Mide la expansión de patrones en un directorio con GLOB_FILES archivos
+ */
+static void bench_glob(void) {
+    char dir[1024], path[1100], cwd[4096];
+    const char *tmp = getenv("TMPDIR");
+    snprintf(dir, sizeof(dir), "%s/dwimsh-glob-XXXXXX", tmp && *tmp ? tmp : "/tmp");
+    if (mkdtemp(dir) == NULL || getcwd(cwd, sizeof(cwd)) == NULL) {
+        perror("bench_glob");
+        return;
+    }
+
+    for (int i = 0; i < GLOB_FILES; i++) {
+        snprintf(path, sizeof(path), "%s/f%06d", dir, i);
+        int fd = open(path, O_WRONLY | O_CREAT, 0644);
+        if (fd >= 0)
+            close(fd);
+    }
+    if (chdir(dir) == 0) {
+        bench_script("glob_echo_star_100k", "echo *");
+        bench_script("glob_echo_suffix_100k", "echo *99");
+        if (chdir(cwd) < 0)
+            perror(cwd);
+    }
+
+    for (int i = 0; i < GLOB_FILES; i++) {
+        snprintf(path, sizeof(path), "%s/f%06d", dir, i);
+        unlink(path);
+    }
+    rmdir(dir);
+}
+
+/**
+ * @brief Benchmarks de extremo a extremo (--bench)
+ * @return 0 si la shell arrancó, 1 si no
+ */
+static int run_bench(void) {
+    Session s;
+    double samples[BENCH_SAMPLES];
+
+    double start = now_us();
+    if (session_start(&s) < 0)
+        return 1;
+    if (session_wait(&s, 0, PROMPT, DEFAULT_TIMEOUT) < 0) {
+        fprintf(stderr, "pty_harness: la shell no mostró el prompt\n");
+        session_close(&s);
+        return 1;
+    }
+    printf("{\"benchmark\": \"startup_to_prompt\", \"ms\": %.2f}\n", (now_us() - start) / 1000);
+
+    report_latency("keystroke_echo", samples, bench_keystrokes(&s, samples, BENCH_SAMPLES));
+    bench_enter(&s, "echo", "enter_to_exec_builtin", "enter_to_prompt_builtin");
+    bench_enter(&s, "/bin/echo", "enter_to_exec_external", "enter_to_prompt_external");
+    bench_keystrokes_under_load(&s);
+
+    session_send(&s, "exit\n");
+    session_close(&s);
+
+    bench_script("script_for_arith_200k", "n=0; for i in $(seq 1 200000); do n=$((n + i)); done; echo $n");
+    bench_script("script_while_test_100k", "i=0; while [ $i -lt 100000 ]; do i=$((i + 1)); done");
+    bench_script("script_loop_true_builtin_5k", "i=0; while [ $i -lt 5000 ]; do true; i=$((i + 1)); done");
+    bench_script("script_loop_true_external_5k", "i=0; while [ $i -lt 5000 ]; do /usr/bin/true; i=$((i + 1)); done");
+    bench_script("script_function_calls_50k", "f() { return 0; }; i=0; while [ $i -lt 50000 ]; do f; i=$((i + 1)); done");
+    bench_glob();
+    return 0;
+}
+
+/**
+ * @brief Punto de entrada del arnés
+ * @param argc Número de argumentos
+ * @param argv --test o --bench y, opcionalmente, la ruta de dwimsh
+ * @return 0 si todo fue bien
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 2 || (strcmp(argv[1], "--test") != 0 && strcmp(argv[1], "--bench") != 0)) {
+        fprintf(stderr, "uso: %s --test|--bench [ruta a dwimsh]\n", argv[0]);
+        return 2;
+    }
+    if (argc > 2)
+        shell_path = argv[2];
+
+    // Ruta absoluta: algunos casos cambian de directorio antes de lanzar la shell
+    static char resolved[4096];
+    if (realpath(shell_path, resolved) != NULL)
+        shell_path = resolved;
+
+    // Si la shell muere, write al terminal no debe matar al arnés
+    signal(SIGPIPE, SIG_IGN);
+
+    return strcmp(argv[1], "--test") == 0 ? run_tests() : run_bench();
+}
@@ -0,0 +1,252 @@
+/**
+ * @file vars.c
+ * @brief Implementación del almacén de variables de DWIMSH
+ *
+ * Las variables se guardan en una tabla hash de direccionamiento abierto
+ * con sondeo lineal. El borrado desplaza hacia atrás las entradas del
+ * mismo grupo para no necesitar marcas de borrado.
+ */
+
+#include "vars.h"
+
+PositionalParams positional_params = {NULL, 0};
+
+// Tabla de variables (la capacidad siempre es potencia de 2)
+static ShellVar *var_table = NULL;
+static size_t var_capacity = 0;
+static size_t var_count = 0;
+
+/**
+ * @brief Calcula el hash FNV-1a de una secuencia de bytes
+ * @param s Bytes a procesar
+ * @param len Número de bytes
+ * @return Valor hash
+ */
+unsigned int hash_bytes(const char *s, size_t len) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)s[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Busca la posición de una variable en la tabla
+ * @param name Nombre de la variable
+ * @param len Longitud del nombre
+ * @param hash Hash del nombre
+ * @return Índice de la variable o de la posición libre donde debería ir
+ */
+static size_t var_slot(const char *name, size_t len, unsigned int hash) {
+    size_t mask = var_capacity - 1;
+    size_t i = hash & mask;
+
+    while (var_table[i].name != NULL) {
+        if (var_table[i].hash == hash &&
+            strncmp(var_table[i].name, name, len) == 0 &&
+            var_table[i].name[len] == '\0') {
+            return i;
+        }
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+/**
+ * @brief Duplica la capacidad de la tabla y reubica las variables
+ */
+static void var_grow(void) {
+    ShellVar *old_table = var_table;
+    size_t old_capacity = var_capacity;
+
+    var_capacity = old_capacity ? old_capacity * 2 : 64;
+    var_table = calloc(var_capacity, sizeof(ShellVar));
+    if (var_table == NULL) {
+        perror("Error al asignar memoria");
+        exit(1);
+    }
+
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_table[i].name == NULL)
+            continue;
+        size_t j = old_table[i].hash & (var_capacity - 1);
+        while (var_table[j].name != NULL)
+            j = (j + 1) & (var_capacity - 1);
+        var_table[j] = old_table[i];
+    }
+    free(old_table);
+}
+
+/**
+ * @brief Importa las variables del entorno como variables exportadas
+ * @param envp Entorno del proceso (terminado en NULL)
+ */
+void vars_init(char **envp) {
+    if (var_table == NULL)
+        var_grow();
+
+    for (int i = 0; envp != NULL && envp[i] != NULL; i++) {
+        char *eq = strchr(envp[i], '=');
+        if (eq == NULL || !is_valid_var_name(envp[i], eq - envp[i]))
+            continue;
+
+        char *name = strndup(envp[i], eq - envp[i]);
+        var_set(name, eq + 1, 1);
+        free(name);
+    }
+}
+
+/**
+ * @brief Obtiene el valor de una variable con nombre no terminado en '\0'
+ * @param name Nombre de la variable
+ * @param len Longitud del nombre
+ * @param hash Hash del nombre calculado con hash_bytes
+ * @return Valor de la variable o NULL si no existe
+ */
+const char *var_get_n(const char *name, size_t len, unsigned int hash) {
+    if (var_table == NULL)
+        return NULL;
+    size_t i = var_slot(name, len, hash);
+    return var_table[i].name ? var_table[i].value : NULL;
+}
+
+/**
+ * @brief Busca la entrada completa de una variable
+ * @param name Nombre de la variable
+ * @return Entrada de la variable o NULL si no existe
+ */
+const ShellVar *var_lookup(const char *name) {
+    if (var_table == NULL)
+        return NULL;
+    size_t len = strlen(name);
+    size_t i = var_slot(name, len, hash_bytes(name, len));
+    return var_table[i].name ? &var_table[i] : NULL;
+}
+
+/**
+ * @brief Obtiene el valor de una variable
+ * @param name Nombre de la variable
+ * @return Valor de la variable o NULL si no existe
+ */
+const char *var_get(const char *name) {
+    const ShellVar *var = var_lookup(name);
+    return var ? var->value : NULL;
+}
+
+/**
+ * @brief Asigna el valor de una variable, creándola si no existe
+ * @param name Nombre de la variable
+ * @param value Nuevo valor
+ * @param export 1 para exportarla, 0 para no exportarla, -1 para conservar el estado
+ *
+ * Si la variable queda exportada, también se actualiza el entorno del
+ * proceso para que execvp la pase a los hijos.
+ */
+void var_set(const char *name, const char *value, int export) {
+    // Mantener la ocupación por debajo del 50% para que el sondeo sea corto
+    if ((var_count + 1) * 2 > var_capacity)
+        var_grow();
+
+    size_t len = strlen(name);
+    unsigned int hash = hash_bytes(name, len);
+    size_t i = var_slot(name, len, hash);
+    ShellVar *var = &var_table[i];
+
+    if (var->name == NULL) {
+        var->name = strdup(name);
+        var->hash = hash;
+        var->exported = 0;
+        var_count++;
+    } else {
+        free(var->value);
+    }
+
+    var->value = strdup(value);
+    if (export != -1)
+        var->exported = export;
+
+    if (var->exported)
+        setenv(name, value, 1);
+    else if (export == 0)
+        unsetenv(name);
+}
+
+/**
+ * @brief Elimina una variable de la shell y del entorno
+ * @param name Nombre de la variable
+ */
+void var_unset(const char *name) {
+    unsetenv(name);
+    if (var_table == NULL)
+        return;
+
+    size_t len = strlen(name);
+    size_t mask = var_capacity - 1;
+    size_t i = var_slot(name, len, hash_bytes(name, len));
+    if (var_table[i].name == NULL)
+        return;
+
+    free(var_table[i].name);
+    free(var_table[i].value);
+    var_table[i].name = NULL;
+    var_count--;
+
+    // Desplazar hacia atrás las entradas que ya no serían alcanzables
+    size_t j = i;
+    while (1) {
+        j = (j + 1) & mask;
+        if (var_table[j].name == NULL)
+            break;
+        size_t home = var_table[j].hash & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            var_table[i] = var_table[j];
+            var_table[j].name = NULL;
+            i = j;
+        }
+    }
+}
+
+/**
+ * @brief Marca una variable existente como exportada
+ * @param name Nombre de la variable
+ * @return 1 si la variable existe, 0 si no
+ */
+int var_export(const char *name) {
+    const char *value = var_get(name);
+    if (value == NULL)
+        return 0;
+    char *copy = strdup(value);
+    var_set(name, copy, 1);
+    free(copy);
+    return 1;
+}
+
+/**
+ * @brief Recorre todas las variables definidas
+ * @param func Función llamada con cada variable
+ */
+void vars_foreach(void (*func)(const ShellVar *var)) {
+    for (size_t i = 0; i < var_capacity; i++) {
+        if (var_table[i].name != NULL)
+            func(&var_table[i]);
+    }
+}
+
+/**
+ * @brief Verifica si una cadena es un nombre de variable válido
+ * @param name Cadena a verificar
+ * @param len Longitud a verificar
+ * @return 1 si es válido, 0 si no
+ *
+ * Un nombre válido empieza con letra o '_' y sigue con letras, dígitos o '_'.
+ */
+int is_valid_var_name(const char *name, size_t len) {
+    if (len == 0 || !(isalpha((unsigned char)name[0]) || name[0] == '_'))
+        return 0;
+    for (size_t i = 1; i < len; i++) {
+        if (!(isalnum((unsigned char)name[i]) || name[i] == '_'))
+            return 0;
+    }
+    return 1;
+}
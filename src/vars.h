@@ -0,0 +1,115 @@
+/**
+ * @file vars.h
+ * @brief Definición del almacén de variables de DWIMSH
+ *
+ * Este archivo define la tabla hash de direccionamiento abierto que guarda
+ * las variables de la shell y del entorno. Las variables exportadas se
+ * sincronizan con el entorno del proceso para que las hereden los hijos.
+ * También declara los parámetros posicionales.
+ */
+
+#ifndef VARS_H
+#define VARS_H
+
+#include "shell.h"
+
+/**
+ * @brief Entrada de la tabla de variables
+ */
+typedef struct {
+    /** Nombre de la variable (NULL si la posición está libre) */
+    char *name;
+    /** Valor de la variable */
+    char *value;
+    /** Hash del nombre, guardado para no recalcularlo al redimensionar */
+    unsigned int hash;
+    /** Indica si la variable se exporta al entorno de los procesos hijos */
+    int exported;
+} ShellVar;
+
+/**
+ * @brief Parámetros posicionales ($0, $1, ...)
+ */
+typedef struct {
+    /** Parámetros; argv[0] es $0 */
+    char **argv;
+    /** Número de parámetros, incluyendo $0 */
+    int argc;
+} PositionalParams;
+
+/** Parámetros posicionales actuales (del script o de la función en ejecución) */
+extern PositionalParams positional_params;
+
+/**
+ * @brief Calcula el hash FNV-1a de una secuencia de bytes
+ * @param s Bytes a procesar
+ * @param len Número de bytes
+ * @return Valor hash
+ */
+unsigned int hash_bytes(const char *s, size_t len);
+
+/**
+ * @brief Importa las variables del entorno como variables exportadas
+ * @param envp Entorno del proceso (terminado en NULL)
+ */
+void vars_init(char **envp);
+
+/**
+ * @brief Obtiene el valor de una variable
+ * @param name Nombre de la variable
+ * @return Valor de la variable o NULL si no existe
+ */
+const char *var_get(const char *name);
+
+/**
+ * @brief Obtiene el valor de una variable con nombre no terminado en '\0'
+ * @param name Nombre de la variable
+ * @param len Longitud del nombre
+ * @param hash Hash del nombre calculado con hash_bytes
+ * @return Valor de la variable o NULL si no existe
+ */
+const char *var_get_n(const char *name, size_t len, unsigned int hash);
+
+/**
+ * @brief Busca la entrada completa de una variable
+ * @param name Nombre de la variable
+ * @return Entrada de la variable o NULL si no existe
+ */
+const ShellVar *var_lookup(const char *name);
+
+/**
+ * @brief Asigna el valor de una variable, creándola si no existe
+ * @param name Nombre de la variable
+ * @param value Nuevo valor
+ * @param export 1 para exportarla, 0 para no exportarla, -1 para conservar el estado
+ */
+void var_set(const char *name, const char *value, int export);
+
+/**
+ * @brief Elimina una variable de la shell y del entorno
+ * @param name Nombre de la variable
+ */
+void var_unset(const char *name);
+
+/**
+ * @brief Marca una variable existente como exportada
+ * @param name Nombre de la variable
+ * @return 1 si la variable existe, 0 si no
+ */
+int var_export(const char *name);
+
+/**
+ * @brief Recorre todas las variables definidas
+ * @param func Función llamada con cada variable
+ */
+void vars_foreach(void (*func)(const ShellVar *var));
+
+/**
+ * @brief Verifica si una cadena es un nombre de variable válido
+ * @param name Cadena a verificar
+ * @param len Longitud a verificar
+ * @return 1 si es válido, 0 si no
+ */
+int is_valid_var_name(const char *name, size_t len);
+
+#endif // VARS_H
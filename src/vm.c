@@ -0,0 +1,1465 @@
+/**
+ * @file vm.c
+ * @brief Implementación del compilador y la máquina virtual de DWIMSH
+ *
+ * Este archivo contiene el analizador sintáctico de las estructuras de
+ * control (if, while, until, for, funciones, &&, ||, !, { } y ( )), su
+ * compilación a bytecode, la caché de programas compilados y la máquina
+ * virtual que los ejecuta.
+ *
+ * Con GCC o Clang la máquina virtual usa despacho directo por hilos: la
+ * primera vez que se ejecuta un programa cada instrucción guarda la
+ * dirección de su rutina (goto calculado), de modo que pasar de una
+ * instrucción a la siguiente es un único salto indirecto. Con otros
+ * compiladores se usa un switch equivalente.
+ */
+
+#include "vm.h"
+#include "vars.h"
+#include "builtins.h"
+
+#if defined(__GNUC__) && !defined(VM_NO_THREADING)
+#define VM_THREADED 1
+#endif
+
+// Tamaño de la caché de programas (potencia de 2) y entradas máximas antes de vaciarla
+#define PROGRAM_CACHE_SIZE 1024
+#define PROGRAM_CACHE_MAX  512
+
+// Tamaño inicial de la tabla de funciones (potencia de 2)
+#define FUNCTION_TABLE_SIZE 64
+
+int function_count = 0;
+int vm_depth = 0;
+volatile sig_atomic_t vm_interrupted = 0;
+
+/* ------------------------------------------------------------------ */
+/* Programas                                                          */
+/* ------------------------------------------------------------------ */
+
+/**
+ * @brief Crea un programa vacío con una referencia
+ * @return Programa reservado con calloc
+ */
+static Program *program_new(void) {
+    Program *prog = calloc(1, sizeof(Program));
+    prog->refcount = 1;
+    return prog;
+}
+
+/**
+ * @brief Libera una referencia a un programa
+ * @param prog Programa (se libera al llegar a 0 referencias)
+ */
+void program_release(Program *prog) {
+    if (prog == NULL || --prog->refcount > 0)
+        return;
+    for (int i = 0; i < prog->ncmds; i++)
+        plan_free(prog->cmds[i]);
+    for (int i = 0; i < prog->nsubs; i++)
+        program_release(prog->subs[i]);
+    for (int i = 0; i < prog->nnames; i++)
+        free(prog->names[i]);
+    free(prog->code);
+    free(prog->cmds);
+    free(prog->subs);
+    free(prog->names);
+    free(prog);
+}
+
+/**
+ * @brief Añade una instrucción al programa
+ * @param prog Programa en construcción
+ * @param op Código de operación
+ * @param a Primer operando
+ * @param b Segundo operando
+ * @return Posición de la instrucción (para corregir saltos después)
+ */
+static int emit(Program *prog, int op, int a, int b) {
+    if (prog->ncode == prog->cap_code) {
+        prog->cap_code = prog->cap_code ? prog->cap_code * 2 : 16;
+        prog->code = realloc(prog->code, prog->cap_code * sizeof(Instr));
+    }
+    Instr *in = &prog->code[prog->ncode];
+    in->handler = NULL;
+    in->op = op;
+    in->a = a;
+    in->b = b;
+    return prog->ncode++;
+}
+
+/**
+ * @brief Añade un comando simple al programa (el programa toma posesión de él)
+ * @param prog Programa en construcción
+ * @param cmd Comando simple
+ * @return Índice del comando
+ */
+static int add_cmd(Program *prog, CommandPlan *cmd) {
+    if (prog->ncmds == prog->cap_cmds) {
+        prog->cap_cmds = prog->cap_cmds ? prog->cap_cmds * 2 : 8;
+        prog->cmds = realloc(prog->cmds, prog->cap_cmds * sizeof(CommandPlan *));
+    }
+    prog->cmds[prog->ncmds] = cmd;
+    return prog->ncmds++;
+}
+
+/**
+ * @brief Añade un subprograma (el programa toma posesión de su referencia)
+ * @param prog Programa en construcción
+ * @param sub Subprograma
+ * @return Índice del subprograma
+ */
+static int add_sub(Program *prog, Program *sub) {
+    if (prog->nsubs == prog->cap_subs) {
+        prog->cap_subs = prog->cap_subs ? prog->cap_subs * 2 : 4;
+        prog->subs = realloc(prog->subs, prog->cap_subs * sizeof(Program *));
+    }
+    prog->subs[prog->nsubs] = sub;
+    return prog->nsubs++;
+}
+
+/**
+ * @brief Añade un nombre (variable de for o función) al programa
+ * @param prog Programa en construcción
+ * @param name Nombre (se copia)
+ * @return Índice del nombre
+ */
+static int add_name(Program *prog, const char *name) {
+    if (prog->nnames == prog->cap_names) {
+        prog->cap_names = prog->cap_names ? prog->cap_names * 2 : 4;
+        prog->names = realloc(prog->names, prog->cap_names * sizeof(char *));
+    }
+    prog->names[prog->nnames] = strdup(name);
+    return prog->nnames++;
+}
+
+/* ------------------------------------------------------------------ */
+/* Analizador sintáctico                                              */
+/* ------------------------------------------------------------------ */
+
+/**
+ * @brief Tipos de token de la gramática
+ */
+typedef enum {
+    TOK_WORD,    /**< Palabra (incluye las palabras reservadas) */
+    TOK_NEWLINE, /**< Salto de línea */
+    TOK_SEMI,    /**< ; */
+    TOK_AMP,     /**< & */
+    TOK_AND,     /**< && */
+    TOK_OR,      /**< || */
+    TOK_LPAREN,  /**< ( */
+    TOK_RPAREN,  /**< ) */
+    TOK_EOF      /**< Fin del texto */
+} TokenType;
+
+/**
+ * @brief Bucle abierto durante la compilación (para break y continue)
+ */
+typedef struct {
+    /** Destino de continue */
+    int continue_target;
+    /** Indica si es un bucle for (tiene un iterador que descartar) */
+    int is_for;
+    /** Saltos de break pendientes de corregir */
+    int *breaks;
+    int nbreaks;
+    int cap_breaks;
+} LoopContext;
+
+/**
+ * @brief Estado del analizador sintáctico
+ */
+typedef struct {
+    /** Posición actual en el texto */
+    const char *p;
+    /** Token leído por adelantado */
+    TokenType type;
+    /** Palabra del token (solo TOK_WORD) */
+    WordPlan word;
+    /** Indica si hay un token leído por adelantado */
+    int have_token;
+    /** 1 mientras no haya problemas, 0 si el texto está incompleto, -1 si hay error */
+    int result;
+    /** Programa que se está generando */
+    Program *prog;
+    /** Bucles abiertos */
+    LoopContext *loops;
+    int nloops;
+    int cap_loops;
+    /** Primer bucle visible desde el programa actual (los cuerpos de funciones empiezan de cero) */
+    int loop_base;
+} Parser;
+
+// Palabras reservadas que terminan una lista de comandos
+static const char *const list_terminators[] = {
+    "then", "elif", "else", "fi", "do", "done", "}", NULL
+};
+
+/**
+ * @brief Marca un error de sintaxis cerca del token actual
+ * @param ps Analizador
+ */
+static void syntax_error(Parser *ps) {
+    static const char *const names[] = {
+        NULL, "nueva línea", ";", "&", "&&", "||", "(", ")", "fin de archivo"
+    };
+
+    if (ps->result != 1)
+        return;
+    if (ps->type == TOK_WORD) {
+        const char *text = ps->word.nsegs > 0 ? ps->word.segs[0].text : "";
+        fprintf(stderr, "dwimsh: error de sintaxis cerca de '%s'\n", text);
+    } else {
+        fprintf(stderr, "dwimsh: error de sintaxis cerca de '%s'\n", names[ps->type]);
+    }
+    ps->result = -1;
+}
+
+/**
+ * @brief Lee el siguiente token si aún no se ha leído
+ * @param ps Analizador
+ * @return Tipo del token actual (TOK_EOF si hubo un error)
+ */
+static TokenType peek(Parser *ps) {
+    if (ps->have_token)
+        return ps->type;
+    if (ps->result != 1)
+        return ps->type = TOK_EOF;
+
+    const char *p = ps->p;
+    for (;;) {
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '\\' && p[1] == '\n') {
+            p += 2;
+        } else if (*p == '#') {
+            while (*p != '\0' && *p != '\n')
+                p++;
+        } else {
+            break;
+        }
+    }
+
+    ps->have_token = 1;
+    switch (*p) {
+        case '\0':
+            ps->type = TOK_EOF;
+            break;
+        case '\n':
+            ps->type = TOK_NEWLINE;
+            p++;
+            break;
+        case ';':
+            ps->type = TOK_SEMI;
+            p++;
+            break;
+        case '(':
+            ps->type = TOK_LPAREN;
+            p++;
+            break;
+        case ')':
+            ps->type = TOK_RPAREN;
+            p++;
+            break;
+        case '&':
+            ps->type = p[1] == '&' ? TOK_AND : TOK_AMP;
+            p += p[1] == '&' ? 2 : 1;
+            break;
+        case '|':
+            if (p[1] != '|') {
+                fprintf(stderr, "dwimsh: las tuberías (|) no están soportadas\n");
+                ps->result = -1;
+                ps->type = TOK_EOF;
+                break;
+            }
+            ps->type = TOK_OR;
+            p += 2;
+            break;
+        default: {
+            int result = lex_word(&p, &ps->word);
+            if (result != 1) {
+                word_free(&ps->word);
+                ps->result = result;
+                ps->type = TOK_EOF;
+            } else {
+                ps->type = TOK_WORD;
+            }
+            break;
+        }
+    }
+    ps->p = p;
+    return ps->type;
+}
+
+/**
+ * @brief Descarta el token actual (liberando su palabra si la tiene)
+ * @param ps Analizador
+ */
+static void consume(Parser *ps) {
+    if (ps->have_token && ps->type == TOK_WORD)
+        word_free(&ps->word);
+    ps->have_token = 0;
+}
+
+/**
+ * @brief Toma la palabra del token actual (quien llama debe liberarla)
+ * @param ps Analizador
+ * @return Palabra del token
+ */
+static WordPlan take_word(Parser *ps) {
+    ps->have_token = 0;
+    return ps->word;
+}
+
+/**
+ * @brief Indica si el token actual es la palabra reservada indicada
+ * @param ps Analizador
+ * @param keyword Palabra reservada
+ * @return 1 si lo es, 0 si no
+ */
+static int peek_keyword(Parser *ps, const char *keyword) {
+    return peek(ps) == TOK_WORD && word_is_keyword(&ps->word, keyword);
+}
+
+/**
+ * @brief Indica si el token actual termina una lista de comandos
+ * @param ps Analizador
+ * @return 1 si es fin de texto, ')' o una palabra reservada de cierre
+ */
+static int at_list_end(Parser *ps) {
+    TokenType type = peek(ps);
+    if (type == TOK_EOF || type == TOK_RPAREN)
+        return 1;
+    if (type != TOK_WORD)
+        return 0;
+    for (int i = 0; list_terminators[i] != NULL; i++) {
+        if (word_is_keyword(&ps->word, list_terminators[i]))
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Descarta saltos de línea
+ * @param ps Analizador
+ */
+static void skip_newlines(Parser *ps) {
+    while (peek(ps) == TOK_NEWLINE)
+        consume(ps);
+}
+
+/**
+ * @brief Marca el error adecuado cuando falta un token esperado
+ * @param ps Analizador
+ *
+ * Si el texto terminó, la línea está incompleta (se pide otra línea);
+ * si no, es un error de sintaxis.
+ */
+static void unexpected(Parser *ps) {
+    if (peek(ps) == TOK_EOF) {
+        if (ps->result == 1)
+            ps->result = 0;
+    } else {
+        syntax_error(ps);
+    }
+}
+
+/**
+ * @brief Consume una palabra reservada obligatoria
+ * @param ps Analizador
+ * @param keyword Palabra reservada esperada
+ * @return 1 si estaba, 0 si no (y se marca el error)
+ */
+static int expect_keyword(Parser *ps, const char *keyword) {
+    if (peek_keyword(ps, keyword)) {
+        consume(ps);
+        return 1;
+    }
+    unexpected(ps);
+    return 0;
+}
+
+static int parse_list(Parser *ps);
+static int parse_command(Parser *ps);
+
+/**
+ * @brief Analiza una lista que no puede estar vacía
+ * @param ps Analizador
+ * @return 1 si se analizó algún comando, 0 si no (y se marca el error)
+ */
+static int parse_body(Parser *ps) {
+    if (parse_list(ps) > 0)
+        return 1;
+    unexpected(ps);
+    return 0;
+}
+
+/**
+ * @brief Corrige el destino de un salto
+ * @param ps Analizador
+ * @param at Posición de la instrucción de salto
+ * @param target Nuevo destino
+ */
+static void patch(Parser *ps, int at, int target) {
+    ps->prog->code[at].a = target;
+}
+
+/**
+ * @brief Abre un bucle para break y continue
+ * @param ps Analizador
+ * @param continue_target Destino de continue
+ * @param is_for Indica si es un bucle for
+ */
+static void loop_push(Parser *ps, int continue_target, int is_for) {
+    if (ps->nloops == ps->cap_loops) {
+        ps->cap_loops = ps->cap_loops ? ps->cap_loops * 2 : 4;
+        ps->loops = realloc(ps->loops, ps->cap_loops * sizeof(LoopContext));
+    }
+    LoopContext *loop = &ps->loops[ps->nloops++];
+    memset(loop, 0, sizeof(*loop));
+    loop->continue_target = continue_target;
+    loop->is_for = is_for;
+}
+
+/**
+ * @brief Cierra el bucle actual corrigiendo sus saltos de break
+ * @param ps Analizador
+ * @param break_target Destino de break
+ */
+static void loop_pop(Parser *ps, int break_target) {
+    LoopContext *loop = &ps->loops[--ps->nloops];
+    for (int i = 0; i < loop->nbreaks; i++)
+        patch(ps, loop->breaks[i], break_target);
+    free(loop->breaks);
+}
+
+/**
+ * @brief Compila break o continue
+ * @param ps Analizador
+ * @param cmd Comando simple (break o continue con su argumento opcional)
+ * @param is_break 1 para break, 0 para continue
+ *
+ * El nivel (break N) debe ser un número literal. Antes de saltar se
+ * descartan los iteradores de los bucles for que se abandonan.
+ */
+static void compile_loop_jump(Parser *ps, CommandPlan *cmd, int is_break) {
+    const char *name = is_break ? "break" : "continue";
+    int visible = ps->nloops - ps->loop_base;
+    int levels = 1;
+
+    if (cmd->nwords > 1) {
+        const WordPlan *arg = &cmd->words[1];
+        levels = (arg->flags & WORD_STATIC) ? atoi(arg->text) : 0;
+        if (levels <= 0) {
+            fprintf(stderr, "dwimsh: %s: se requiere un número positivo\n", name);
+            ps->result = -1;
+            return;
+        }
+    }
+
+    if (visible == 0) {
+        // Fuera de un bucle no hace nada (como en bash)
+        emit(ps->prog, OP_SET_STATUS, 0, 0);
+        return;
+    }
+    if (levels > visible)
+        levels = visible;
+
+    for (int i = 1; i < levels; i++) {
+        if (ps->loops[ps->nloops - i].is_for)
+            emit(ps->prog, OP_FOR_POP, 0, 0);
+    }
+
+    LoopContext *loop = &ps->loops[ps->nloops - levels];
+    if (is_break) {
+        emit(ps->prog, OP_SET_STATUS, 0, 0);
+        if (loop->nbreaks == loop->cap_breaks) {
+            loop->cap_breaks = loop->cap_breaks ? loop->cap_breaks * 2 : 4;
+            loop->breaks = realloc(loop->breaks, loop->cap_breaks * sizeof(int));
+        }
+        loop->breaks[loop->nbreaks++] = emit(ps->prog, OP_JMP, -1, 0);
+    } else {
+        emit(ps->prog, OP_JMP, loop->continue_target, 0);
+    }
+}
+
+/**
+ * @brief Añade una palabra a un comando simple
+ * @param cmd Comando simple
+ * @param word Palabra (el comando toma posesión de ella)
+ */
+static void cmd_push_word(CommandPlan *cmd, WordPlan word) {
+    cmd->words = realloc(cmd->words, (cmd->nwords + 1) * sizeof(WordPlan));
+    cmd->words[cmd->nwords++] = word;
+}
+
+/**
+ * @brief Busca el índice de un built-in por nombre
+ * @param name Nombre del comando
+ * @return Índice en builtin_commands o -1 si no es un built-in
+ */
+static int find_builtin(const char *name) {
+    for (int i = 0; i < num_builtin_commands; i++) {
+        if (strcmp(name, builtin_commands[i].name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Analiza la definición de una función: nombre() comando-compuesto
+ * @param ps Analizador (el token actual es el '(' tras el nombre)
+ * @param cmd Comando simple con el nombre como única palabra (se libera aquí)
+ */
+static void parse_function(Parser *ps, CommandPlan *cmd) {
+    const WordPlan *name = &cmd->words[0];
+
+    consume(ps);
+    if (!(name->flags & WORD_STATIC)) {
+        fprintf(stderr, "dwimsh: nombre de función no válido\n");
+        ps->result = -1;
+        plan_free(cmd);
+        return;
+    }
+    if (peek(ps) != TOK_RPAREN) {
+        unexpected(ps);
+        plan_free(cmd);
+        return;
+    }
+    consume(ps);
+    skip_newlines(ps);
+
+    if (!peek_keyword(ps, "{") && !peek_keyword(ps, "if") && !peek_keyword(ps, "while") &&
+        !peek_keyword(ps, "until") && !peek_keyword(ps, "for") && peek(ps) != TOK_LPAREN) {
+        unexpected(ps);
+        plan_free(cmd);
+        return;
+    }
+
+    // El cuerpo se compila como un programa independiente
+    Program *outer = ps->prog;
+    int saved_base = ps->loop_base;
+    Program *body = program_new();
+    ps->prog = body;
+    ps->loop_base = ps->nloops;
+
+    parse_command(ps);
+    emit(body, OP_HALT, 0, 0);
+
+    ps->loop_base = saved_base;
+    ps->prog = outer;
+
+    int name_index = add_name(outer, name->text);
+    int sub_index = add_sub(outer, body);
+    emit(outer, OP_DEFUN, name_index, sub_index);
+    plan_free(cmd);
+}
+
+/**
+ * @brief Analiza un comando simple
+ * @param ps Analizador (el token actual es una palabra)
+ * @return Índice del comando si es un comando que puede ir en segundo plano, -1 si no
+ */
+static int parse_simple(Parser *ps) {
+    CommandPlan *cmd = calloc(1, sizeof(CommandPlan));
+    int assign_ok = 1;
+    int nassign = 0;
+
+    cmd->builtin = -1;
+    while (peek(ps) == TOK_WORD) {
+        WordPlan word = take_word(ps);
+        word_finalize(&word, assign_ok);
+        if (word.flags & WORD_ASSIGN)
+            nassign++;
+        else
+            assign_ok = 0;
+        cmd_push_word(cmd, word);
+
+        if (cmd->nwords == 1 && nassign == 0 && peek(ps) == TOK_LPAREN) {
+            parse_function(ps, cmd);
+            return -1;
+        }
+    }
+
+    if (nassign == cmd->nwords) {
+        emit(ps->prog, OP_ASSIGN, add_cmd(ps->prog, cmd), 0);
+        return -1;
+    }
+
+    const WordPlan *first = &cmd->words[nassign];
+    if (nassign == 0 && (first->flags & WORD_STATIC)) {
+        if (strcmp(first->text, "break") == 0 || strcmp(first->text, "continue") == 0) {
+            compile_loop_jump(ps, cmd, first->text[0] == 'b');
+            plan_free(cmd);
+            return -1;
+        }
+        if (strcmp(first->text, "return") == 0) {
+            if (cmd->nwords == 1) {
+                plan_free(cmd);
+                emit(ps->prog, OP_RETURN, -1, 0);
+            } else {
+                emit(ps->prog, OP_RETURN, add_cmd(ps->prog, cmd), 0);
+            }
+            return -1;
+        }
+        cmd->builtin = find_builtin(first->text);
+    }
+
+    int index = add_cmd(ps->prog, cmd);
+    emit(ps->prog, OP_EXEC, index, 0);
+    return index;
+}
+
+/**
+ * @brief Analiza if lista; then lista; [elif lista; then lista;]... [else lista;] fi
+ * @param ps Analizador (el token actual es "if")
+ */
+static void parse_if(Parser *ps) {
+    Program *prog = ps->prog;
+    int *ends = NULL;
+    int nends = 0;
+
+    consume(ps);
+    for (;;) {
+        if (!parse_body(ps) || !expect_keyword(ps, "then"))
+            break;
+        int jfalse = emit(prog, OP_JFALSE, -1, 0);
+        if (!parse_body(ps))
+            break;
+
+        ends = realloc(ends, (nends + 1) * sizeof(int));
+        ends[nends++] = emit(prog, OP_JMP, -1, 0);
+        patch(ps, jfalse, prog->ncode);
+
+        if (peek_keyword(ps, "elif")) {
+            consume(ps);
+            continue;
+        }
+        if (peek_keyword(ps, "else")) {
+            consume(ps);
+            parse_body(ps);
+        } else {
+            // Sin rama else, un if cuya condición falla termina con estado 0
+            emit(prog, OP_SET_STATUS, 0, 0);
+        }
+        expect_keyword(ps, "fi");
+        break;
+    }
+
+    for (int i = 0; i < nends; i++)
+        patch(ps, ends[i], prog->ncode);
+    free(ends);
+}
+
+/**
+ * @brief Analiza while lista; do lista; done (o until)
+ * @param ps Analizador (el token actual es "while" o "until")
+ *
+ * El estado del bucle es el del último cuerpo ejecutado (0 si ninguno);
+ * se guarda en una ranura porque la condición lo sobrescribe.
+ */
+static void parse_while(Parser *ps) {
+    Program *prog = ps->prog;
+    int until = word_is_keyword(&ps->word, "until");
+    int slot = prog->nslots++;
+
+    consume(ps);
+    emit(prog, OP_SET_STATUS, 0, 0);
+    emit(prog, OP_STORE_STATUS, slot, 0);
+
+    int top = prog->ncode;
+    loop_push(ps, top, 0);
+    int exit_jump = -1;
+    if (parse_body(ps) && expect_keyword(ps, "do")) {
+        exit_jump = emit(prog, until ? OP_JTRUE : OP_JFALSE, -1, 0);
+        if (parse_body(ps) && expect_keyword(ps, "done")) {
+            emit(prog, OP_STORE_STATUS, slot, 0);
+            emit(prog, OP_JMP, top, 0);
+        }
+    }
+    if (exit_jump >= 0)
+        patch(ps, exit_jump, prog->ncode);
+    emit(prog, OP_LOAD_STATUS, slot, 0);
+    loop_pop(ps, prog->ncode);
+}
+
+/**
+ * @brief Analiza for nombre [in palabras...]; do lista; done
+ * @param ps Analizador (el token actual es "for")
+ */
+static void parse_for(Parser *ps) {
+    Program *prog = ps->prog;
+
+    consume(ps);
+    if (peek(ps) != TOK_WORD) {
+        unexpected(ps);
+        return;
+    }
+    WordPlan name = take_word(ps);
+    word_finalize(&name, 0);
+    if (!(name.flags & WORD_STATIC) || !is_valid_var_name(name.text, strlen(name.text))) {
+        fprintf(stderr, "dwimsh: for: '%s': identificador no válido\n",
+                name.nsegs > 0 ? name.segs[0].text : "");
+        word_free(&name);
+        ps->result = -1;
+        return;
+    }
+    int name_index = add_name(prog, name.text);
+    word_free(&name);
+
+    // Sin "in" se recorren los parámetros posicionales
+    int list_index = -1;
+    skip_newlines(ps);
+    if (peek_keyword(ps, "in")) {
+        consume(ps);
+        CommandPlan *list = calloc(1, sizeof(CommandPlan));
+        list->builtin = -1;
+        while (peek(ps) == TOK_WORD) {
+            WordPlan word = take_word(ps);
+            word_finalize(&word, 0);
+            cmd_push_word(list, word);
+        }
+        list_index = add_cmd(prog, list);
+        if (peek(ps) != TOK_SEMI && peek(ps) != TOK_NEWLINE) {
+            unexpected(ps);
+            return;
+        }
+        consume(ps);
+    } else if (peek(ps) == TOK_SEMI) {
+        consume(ps);
+    }
+    skip_newlines(ps);
+    if (!expect_keyword(ps, "do"))
+        return;
+
+    int slot = prog->nslots++;
+    emit(prog, OP_SET_STATUS, 0, 0);
+    emit(prog, OP_STORE_STATUS, slot, 0);
+    emit(prog, OP_FOR_INIT, list_index, 0);
+    int next = emit(prog, OP_FOR_NEXT, -1, name_index);
+
+    loop_push(ps, next, 1);
+    if (parse_body(ps) && expect_keyword(ps, "done")) {
+        emit(prog, OP_STORE_STATUS, slot, 0);
+        emit(prog, OP_JMP, next, 0);
+    }
+    patch(ps, next, prog->ncode);
+    emit(prog, OP_LOAD_STATUS, slot, 0);
+    loop_pop(ps, prog->ncode);
+    emit(prog, OP_FOR_POP, 0, 0);
+}
+
+/**
+ * @brief Analiza ( lista ), que se ejecuta en un proceso hijo
+ * @param ps Analizador (el token actual es '(')
+ */
+static void parse_subshell(Parser *ps) {
+    Program *outer = ps->prog;
+    int saved_base = ps->loop_base;
+    Program *body = program_new();
+
+    consume(ps);
+    ps->prog = body;
+    ps->loop_base = ps->nloops;
+    if (parse_body(ps)) {
+        if (peek(ps) == TOK_RPAREN)
+            consume(ps);
+        else
+            unexpected(ps);
+    }
+    emit(body, OP_HALT, 0, 0);
+    ps->loop_base = saved_base;
+    ps->prog = outer;
+
+    emit(outer, OP_SUBSHELL, add_sub(outer, body), 0);
+}
+
+/**
+ * @brief Analiza un comando (simple o compuesto)
+ * @param ps Analizador
+ * @return Índice del comando si es simple y puede ir en segundo plano, -1 si no
+ */
+static int parse_command(Parser *ps) {
+    TokenType type = peek(ps);
+
+    if (type == TOK_LPAREN) {
+        parse_subshell(ps);
+        return -1;
+    }
+    if (type != TOK_WORD) {
+        unexpected(ps);
+        return -1;
+    }
+
+    if (word_is_keyword(&ps->word, "if")) {
+        parse_if(ps);
+    } else if (word_is_keyword(&ps->word, "while") || word_is_keyword(&ps->word, "until")) {
+        parse_while(ps);
+    } else if (word_is_keyword(&ps->word, "for")) {
+        parse_for(ps);
+    } else if (word_is_keyword(&ps->word, "{")) {
+        consume(ps);
+        if (parse_body(ps))
+            expect_keyword(ps, "}");
+    } else if (at_list_end(ps)) {
+        syntax_error(ps);
+    } else {
+        return parse_simple(ps);
+    }
+    return -1;
+}
+
+/**
+ * @brief Analiza una tubería (aquí solo un comando, opcionalmente negado con !)
+ * @param ps Analizador
+ * @return Índice del comando si es simple y puede ir en segundo plano, -1 si no
+ */
+static int parse_pipeline(Parser *ps) {
+    if (peek_keyword(ps, "!")) {
+        consume(ps);
+        parse_command(ps);
+        emit(ps->prog, OP_NOT, 0, 0);
+        return -1;
+    }
+    return parse_command(ps);
+}
+
+/**
+ * @brief Analiza comandos unidos con && y ||
+ * @param ps Analizador
+ * @return Índice del comando si es un único comando simple, -1 si no
+ *
+ * "a && b" salta al final si a falla y "a || b" si a tiene éxito; como
+ * el estado no cambia al saltar, las cadenas se evalúan de izquierda a
+ * derecha igual que en sh.
+ */
+static int parse_and_or(Parser *ps) {
+    int index = parse_pipeline(ps);
+
+    while (ps->result == 1 && (peek(ps) == TOK_AND || peek(ps) == TOK_OR)) {
+        int op = peek(ps) == TOK_AND ? OP_JFALSE : OP_JTRUE;
+        consume(ps);
+        skip_newlines(ps);
+        int jump = emit(ps->prog, op, -1, 0);
+        parse_pipeline(ps);
+        patch(ps, jump, ps->prog->ncode);
+        index = -1;
+    }
+    return index;
+}
+
+/**
+ * @brief Analiza una lista de comandos separados por ;, & o saltos de línea
+ * @param ps Analizador
+ * @return Número de comandos analizados
+ */
+static int parse_list(Parser *ps) {
+    int count = 0;
+
+    while (ps->result == 1) {
+        while (peek(ps) == TOK_NEWLINE || peek(ps) == TOK_SEMI)
+            consume(ps);
+        if (at_list_end(ps))
+            break;
+
+        int index = parse_and_or(ps);
+        count++;
+        if (ps->result != 1)
+            break;
+
+        TokenType type = peek(ps);
+        if (type == TOK_AMP) {
+            if (index < 0) {
+                fprintf(stderr, "dwimsh: solo los comandos simples pueden ejecutarse en segundo plano\n");
+                ps->result = -1;
+                break;
+            }
+            ps->prog->cmds[index]->background = 1;
+            consume(ps);
+        } else if (type == TOK_SEMI || type == TOK_NEWLINE) {
+            consume(ps);
+        } else if (!at_list_end(ps)) {
+            syntax_error(ps);
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Libera el estado del analizador
+ * @param ps Analizador
+ */
+static void parser_free(Parser *ps) {
+    consume(ps);
+    for (int i = 0; i < ps->nloops; i++)
+        free(ps->loops[i].breaks);
+    free(ps->loops);
+}
+
+/**
+ * @brief Compila un texto completo (una o varias líneas)
+ * @param text Texto a compilar
+ * @param out Programa compilado (solo si el resultado es 1)
+ * @return 1 si es correcto, 0 si está incompleto, -1 si hay error de sintaxis
+ */
+int program_compile(const char *text, Program **out) {
+    Parser ps;
+    memset(&ps, 0, sizeof(ps));
+    ps.p = text;
+    ps.result = 1;
+    ps.prog = program_new();
+
+    parse_list(&ps);
+    if (ps.result == 1 && peek(&ps) != TOK_EOF)
+        syntax_error(&ps);
+    emit(ps.prog, OP_HALT, 0, 0);
+
+    int result = ps.result;
+    parser_free(&ps);
+    if (result != 1) {
+        program_release(ps.prog);
+        return result;
+    }
+    *out = ps.prog;
+    return 1;
+}
+
+/**
+ * @brief Compila el contenido de una sustitución $(...)
+ * @param pp Posición tras "$(", se avanza hasta después del ')' final
+ * @param out Programa compilado (solo si el resultado es 1)
+ * @return 1 si es correcto, 0 si está incompleto, -1 si hay error de sintaxis
+ */
+int vm_compile_subst(const char **pp, Program **out) {
+    Parser ps;
+    memset(&ps, 0, sizeof(ps));
+    ps.p = *pp;
+    ps.result = 1;
+    ps.prog = program_new();
+
+    parse_list(&ps);
+    if (ps.result == 1) {
+        if (peek(&ps) == TOK_RPAREN)
+            consume(&ps);
+        else
+            unexpected(&ps);
+    }
+    emit(ps.prog, OP_HALT, 0, 0);
+
+    int result = ps.result;
+    parser_free(&ps);
+    if (result != 1) {
+        program_release(ps.prog);
+        return result;
+    }
+    *pp = ps.p;
+    *out = ps.prog;
+    return 1;
+}
+
+/* ------------------------------------------------------------------ */
+/* Caché de programas                                                 */
+/* ------------------------------------------------------------------ */
+
+/**
+ * @brief Entrada de la caché de programas
+ */
+typedef struct {
+    char *line;
+    unsigned int hash;
+    Program *prog;
+} ProgramCacheEntry;
+
+static ProgramCacheEntry program_cache[PROGRAM_CACHE_SIZE];
+static int program_cache_count = 0;
+
+/**
+ * @brief Vacía la caché de programas
+ */
+static void program_cache_clear(void) {
+    for (int i = 0; i < PROGRAM_CACHE_SIZE; i++) {
+        if (program_cache[i].line != NULL) {
+            free(program_cache[i].line);
+            program_release(program_cache[i].prog);
+            program_cache[i].line = NULL;
+        }
+    }
+    program_cache_count = 0;
+}
+
+/**
+ * @brief Obtiene el programa de una línea desde la caché, compilándolo si falta
+ * @param line Línea de comando (tal como se guarda en el historial)
+ * @param result 1 si es correcto, 0 si está incompleto, -1 si hay error
+ * @return Programa de la línea o NULL si no se pudo compilar
+ *
+ * Volver a ejecutar una línea del historial no necesita análisis léxico
+ * ni sintáctico. Cuando la caché se llena se vacía por completo; los
+ * programas en ejecución siguen vivos gracias a su contador de referencias.
+ */
+Program *program_cache_lookup(const char *line, int *result) {
+    unsigned int hash = hash_bytes(line, strlen(line));
+    size_t i = hash & (PROGRAM_CACHE_SIZE - 1);
+
+    while (program_cache[i].line != NULL) {
+        if (program_cache[i].hash == hash && strcmp(program_cache[i].line, line) == 0) {
+            *result = 1;
+            return program_cache[i].prog;
+        }
+        i = (i + 1) & (PROGRAM_CACHE_SIZE - 1);
+    }
+
+    Program *prog;
+    *result = program_compile(line, &prog);
+    if (*result != 1)
+        return NULL;
+
+    if (program_cache_count >= PROGRAM_CACHE_MAX) {
+        program_cache_clear();
+        i = hash & (PROGRAM_CACHE_SIZE - 1);
+    }
+
+    program_cache[i].line = strdup(line);
+    program_cache[i].hash = hash;
+    program_cache[i].prog = prog;
+    program_cache_count++;
+    return prog;
+}
+
+/* ------------------------------------------------------------------ */
+/* Funciones de la shell                                              */
+/* ------------------------------------------------------------------ */
+
+/**
+ * @brief Entrada de la tabla de funciones
+ */
+typedef struct {
+    char *name;
+    unsigned int hash;
+    Program *body;
+} ShellFunction;
+
+static ShellFunction *functions = NULL;
+static size_t function_capacity = 0;
+
+/**
+ * @brief Busca la posición de una función en la tabla
+ * @param name Nombre de la función
+ * @param hash Hash del nombre
+ * @return Posición de la función o de la celda libre donde iría
+ */
+static size_t function_slot(const char *name, unsigned int hash) {
+    size_t i = hash & (function_capacity - 1);
+    while (functions[i].name != NULL) {
+        if (functions[i].hash == hash && strcmp(functions[i].name, name) == 0)
+            return i;
+        i = (i + 1) & (function_capacity - 1);
+    }
+    return i;
+}
+
+/**
+ * @brief Define (o redefine) una función
+ * @param name Nombre de la función
+ * @param body Cuerpo compilado (se toma una referencia nueva)
+ */
+static void function_define(const char *name, Program *body) {
+    if (function_capacity == 0) {
+        function_capacity = FUNCTION_TABLE_SIZE;
+        functions = calloc(function_capacity, sizeof(ShellFunction));
+    } else if ((size_t)(function_count + 1) * 2 > function_capacity) {
+        ShellFunction *old = functions;
+        size_t old_capacity = function_capacity;
+        function_capacity *= 2;
+        functions = calloc(function_capacity, sizeof(ShellFunction));
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old[i].name != NULL)
+                functions[function_slot(old[i].name, old[i].hash)] = old[i];
+        }
+        free(old);
+    }
+
+    unsigned int hash = hash_bytes(name, strlen(name));
+    size_t i = function_slot(name, hash);
+    body->refcount++;
+    if (functions[i].name != NULL) {
+        program_release(functions[i].body);
+    } else {
+        functions[i].name = strdup(name);
+        functions[i].hash = hash;
+        function_count++;
+    }
+    functions[i].body = body;
+}
+
+/**
+ * @brief Llama a una función de la shell si existe
+ * @param argv Argumentos (argv[0] es el nombre de la función)
+ * @return 1 si la función existía y se ejecutó, 0 si no
+ *
+ * Durante la llamada los parámetros posicionales son los argumentos de
+ * la función; $0 no cambia.
+ */
+int vm_call_function(char **argv) {
+    if (function_count == 0)
+        return 0;
+
+    size_t i = function_slot(argv[0], hash_bytes(argv[0], strlen(argv[0])));
+    if (functions[i].name == NULL)
+        return 0;
+
+    PositionalParams saved = positional_params;
+    int argc = 0;
+    while (argv[argc] != NULL)
+        argc++;
+
+    char **params = malloc((argc + 1) * sizeof(char *));
+    params[0] = saved.argc > 0 ? saved.argv[0] : "dwimsh";
+    for (int j = 1; j <= argc; j++)
+        params[j] = argv[j];
+    positional_params.argv = params;
+    positional_params.argc = argc;
+
+    vm_run(functions[i].body);
+
+    positional_params = saved;
+    free(params);
+    return 1;
+}
+
+/**
+ * @brief Indica si hay una función de la shell con ese nombre
+ * @param name Nombre
+ * @return 1 si existe, 0 si no
+ */
+int vm_function_exists(const char *name) {
+    if (function_count == 0)
+        return 0;
+    return functions[function_slot(name, hash_bytes(name, strlen(name)))].name != NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/* Máquina virtual                                                    */
+/* ------------------------------------------------------------------ */
+
+/**
+ * @brief Iterador de un bucle for en ejecución
+ */
+typedef struct {
+    ArgList values;
+    int next;
+} ForIterator;
+
+static ForIterator *iterators = NULL;
+static int iterator_count = 0;
+static int iterator_capacity = 0;
+
+/**
+ * @brief Descarta el iterador del bucle for más interno
+ */
+static void iterator_pop(void) {
+    arglist_free(&iterators[--iterator_count].values);
+}
+
+/**
+ * @brief Espera a un hijo en primer plano y guarda su estado de salida
+ * @param pid PID del hijo
+ */
+static void wait_foreground(pid_t pid) {
+    int status;
+
+    current_child_pid = pid;
+    foreground_process_running = 1;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+        ;
+    if (WIFEXITED(status))
+        last_command_status = WEXITSTATUS(status);
+    else if (WIFSIGNALED(status))
+        last_command_status = 1;
+    current_child_pid = 0;
+    foreground_process_running = 0;
+}
+
+/**
+ * @brief Ejecuta un programa en la máquina virtual
+ * @param prog Programa a ejecutar
+ *
+ * El estado de cada comando queda en last_command_status, que es el
+ * único "registro" de la máquina; los saltos condicionales lo consultan
+ * directamente. Los bucles comprueban vm_interrupted en cada vuelta
+ * para que Ctrl+C los detenga.
+ */
+void vm_run(Program *prog) {
+    int base = iterator_count;
+    int slots[prog->nslots > 0 ? prog->nslots : 1];
+    const Instr *code = prog->code;
+    const Instr *ip = code;
+
+    // Un programa puede redefinirse (y liberarse) mientras se ejecuta
+    prog->refcount++;
+    vm_depth++;
+
+#ifdef VM_THREADED
+#define VM_CASE(op) op##_label:
+#define VM_NEXT() goto *(++ip)->handler
+#define VM_JUMP(target) do { ip = code + (target); goto *ip->handler; } while (0)
+
+    static const void *const labels[OP_COUNT] = {
+        [OP_EXEC] = &&OP_EXEC_label,
+        [OP_ASSIGN] = &&OP_ASSIGN_label,
+        [OP_JMP] = &&OP_JMP_label,
+        [OP_JFALSE] = &&OP_JFALSE_label,
+        [OP_JTRUE] = &&OP_JTRUE_label,
+        [OP_NOT] = &&OP_NOT_label,
+        [OP_SET_STATUS] = &&OP_SET_STATUS_label,
+        [OP_STORE_STATUS] = &&OP_STORE_STATUS_label,
+        [OP_LOAD_STATUS] = &&OP_LOAD_STATUS_label,
+        [OP_FOR_INIT] = &&OP_FOR_INIT_label,
+        [OP_FOR_NEXT] = &&OP_FOR_NEXT_label,
+        [OP_FOR_POP] = &&OP_FOR_POP_label,
+        [OP_DEFUN] = &&OP_DEFUN_label,
+        [OP_SUBSHELL] = &&OP_SUBSHELL_label,
+        [OP_RETURN] = &&OP_RETURN_label,
+        [OP_HALT] = &&OP_HALT_label,
+    };
+
+    // Traducir los códigos de operación a direcciones una sola vez
+    if (!prog->threaded) {
+        for (int i = 0; i < prog->ncode; i++)
+            prog->code[i].handler = labels[prog->code[i].op];
+        prog->threaded = 1;
+    }
+    goto *ip->handler;
+#else
+#define VM_CASE(op) case op:
+#define VM_NEXT() do { ip++; goto dispatch; } while (0)
+#define VM_JUMP(target) do { ip = code + (target); goto dispatch; } while (0)
+
+dispatch:
+    switch (ip->op) {
+#endif
+
+    VM_CASE(OP_EXEC)
+        execute_plan(prog->cmds[ip->a]);
+        if (vm_interrupted)
+            goto done;
+        VM_NEXT();
+
+    VM_CASE(OP_ASSIGN) {
+        ArgList args = {NULL, 0, 0};
+        // Como en sh, el estado es 0 salvo que lo fije una sustitución $(...)
+        last_command_status = 0;
+        expand_failed = 0;
+        plan_expand(prog->cmds[ip->a], &args);
+        if (expand_failed) {
+            last_command_status = 1;
+        } else {
+            for (int i = 0; i < args.argc; i++) {
+                char *eq = strchr(args.argv[i], '=');
+                *eq = '\0';
+                var_set(args.argv[i], eq + 1, -1);
+            }
+        }
+        arglist_free(&args);
+        VM_NEXT();
+    }
+
+    VM_CASE(OP_JMP)
+        if (vm_interrupted)
+            goto done;
+        VM_JUMP(ip->a);
+
+    VM_CASE(OP_JFALSE)
+        if (last_command_status != 0)
+            VM_JUMP(ip->a);
+        VM_NEXT();
+
+    VM_CASE(OP_JTRUE)
+        if (last_command_status == 0)
+            VM_JUMP(ip->a);
+        VM_NEXT();
+
+    VM_CASE(OP_NOT)
+        last_command_status = last_command_status == 0;
+        VM_NEXT();
+
+    VM_CASE(OP_SET_STATUS)
+        last_command_status = ip->a;
+        VM_NEXT();
+
+    VM_CASE(OP_STORE_STATUS)
+        slots[ip->a] = last_command_status;
+        VM_NEXT();
+
+    VM_CASE(OP_LOAD_STATUS)
+        last_command_status = slots[ip->a];
+        VM_NEXT();
+
+    VM_CASE(OP_FOR_INIT) {
+        if (iterator_count == iterator_capacity) {
+            iterator_capacity = iterator_capacity ? iterator_capacity * 2 : 8;
+            iterators = realloc(iterators, iterator_capacity * sizeof(ForIterator));
+        }
+        ForIterator *it = &iterators[iterator_count++];
+        memset(it, 0, sizeof(*it));
+        if (ip->a >= 0) {
+            expand_failed = 0;
+            plan_expand(prog->cmds[ip->a], &it->values);
+            if (expand_failed)
+                arglist_free(&it->values);
+        } else {
+            for (int i = 1; i < positional_params.argc; i++)
+                arglist_push(&it->values, strdup(positional_params.argv[i]));
+        }
+        VM_NEXT();
+    }
+
+    VM_CASE(OP_FOR_NEXT) {
+        ForIterator *it = &iterators[iterator_count - 1];
+        if (vm_interrupted)
+            goto done;
+        if (it->next >= it->values.argc)
+            VM_JUMP(ip->a);
+        var_set(prog->names[ip->b], it->values.argv[it->next++], -1);
+        VM_NEXT();
+    }
+
+    VM_CASE(OP_FOR_POP)
+        iterator_pop();
+        VM_NEXT();
+
+    VM_CASE(OP_DEFUN)
+        function_define(prog->names[ip->a], prog->subs[ip->b]);
+        last_command_status = 0;
+        VM_NEXT();
+
+    VM_CASE(OP_SUBSHELL) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            last_command_status = 1;
+        } else if (pid == 0) {
+            signal(SIGINT, SIG_DFL);
+            subshell = 1;
+            vm_run(prog->subs[ip->a]);
+            fflush(stdout);
+            _exit(last_command_status);
+        } else {
+            wait_foreground(pid);
+        }
+        if (vm_interrupted)
+            goto done;
+        VM_NEXT();
+    }
+
+    VM_CASE(OP_RETURN)
+        if (ip->a >= 0) {
+            ArgList args = {NULL, 0, 0};
+            plan_expand(prog->cmds[ip->a], &args);
+            if (args.argc > 1) {
+                char *end;
+                long value = strtol(args.argv[1], &end, 10);
+                if (*args.argv[1] == '\0' || *end != '\0') {
+                    fprintf(stderr, "dwimsh: return: %s: se requiere un argumento numérico\n",
+                            args.argv[1]);
+                    value = 2;
+                }
+                last_command_status = (int)(value & 0xff);
+            }
+            arglist_free(&args);
+        }
+        goto done;
+
+    VM_CASE(OP_HALT)
+        goto done;
+
+#ifndef VM_THREADED
+        default:
+            goto done;
+    }
+#endif
+
+#undef VM_CASE
+#undef VM_NEXT
+#undef VM_JUMP
+
+done:
+    while (iterator_count > base)
+        iterator_pop();
+    vm_depth--;
+    program_release(prog);
+}
+
+/**
+ * @brief Ejecuta un programa desde el nivel superior (línea o script)
+ * @param prog Programa a ejecutar
+ */
+void vm_execute(Program *prog) {
+    vm_interrupted = 0;
+    vm_run(prog);
+    vm_interrupted = 0;
+}
+
+/**
+ * @brief Ejecuta un programa en un hijo y captura su salida estándar
+ * @param prog Programa a ejecutar
+ * @return Salida capturada sin saltos de línea finales (reservada con malloc)
+ *
+ * El estado de salida del hijo queda en last_command_status, como en sh.
+ */
+char *vm_capture(Program *prog) {
+    int fds[2];
+
+    if (pipe(fds) < 0) {
+        perror("pipe");
+        last_command_status = 1;
+        return strdup("");
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        last_command_status = 1;
+        return strdup("");
+    }
+    if (pid == 0) {
+        signal(SIGINT, SIG_DFL);
+        subshell = 1;
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[1]);
+        vm_run(prog);
+        fflush(stdout);
+        _exit(last_command_status);
+    }
+
+    close(fds[1]);
+    current_child_pid = pid;
+    foreground_process_running = 1;
+
+    size_t len = 0, cap = 4096;
+    char *out = malloc(cap);
+    for (;;) {
+        if (cap - len < 4096) {
+            cap *= 2;
+            out = realloc(out, cap);
+        }
+        ssize_t n = read(fds[0], out + len, cap - len - 1);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        len += n;
+    }
+    close(fds[0]);
+    wait_foreground(pid);
+
+    while (len > 0 && out[len - 1] == '\n')
+        len--;
+    out[len] = '\0';
+    return out;
+}
@@ -0,0 +1,154 @@
+/**
+ * @file vm.h
+ * @brief Definición del compilador y la máquina virtual de DWIMSH
+ *
+ * Las líneas de comando (incluyendo if, while, until, for, funciones,
+ * &&, || y subshells) se compilan una sola vez a un bytecode compacto que
+ * ejecuta una máquina virtual con despacho directo por hilos (threaded
+ * code). Los bucles no vuelven a analizar el texto en cada iteración.
+ */
+
+#ifndef VM_H
+#define VM_H
+
+#include "shell.h"
+#include "expand.h"
+
+/**
+ * @brief Códigos de operación del bytecode
+ */
+typedef enum {
+    OP_EXEC,         /**< Ejecuta el comando simple cmds[a] */
+    OP_ASSIGN,       /**< Ejecuta las asignaciones del comando cmds[a] */
+    OP_JMP,          /**< Salta a a */
+    OP_JFALSE,       /**< Salta a a si el último estado no es 0 */
+    OP_JTRUE,        /**< Salta a a si el último estado es 0 */
+    OP_NOT,          /**< Invierte el último estado (!) */
+    OP_SET_STATUS,   /**< Fija el último estado a a */
+    OP_STORE_STATUS, /**< Guarda el último estado en la ranura a */
+    OP_LOAD_STATUS,  /**< Recupera el último estado de la ranura a */
+    OP_FOR_INIT,     /**< Expande las palabras de cmds[a] ("$@" si a < 0) y crea un iterador */
+    OP_FOR_NEXT,     /**< Asigna el siguiente valor a names[b] o salta a a si no quedan */
+    OP_FOR_POP,      /**< Descarta el iterador del bucle for actual */
+    OP_DEFUN,        /**< Define la función names[a] con el cuerpo subs[b] */
+    OP_SUBSHELL,     /**< Ejecuta subs[a] en un proceso hijo */
+    OP_RETURN,       /**< Termina el programa con el estado de cmds[a] (si a >= 0) */
+    OP_HALT,         /**< Termina el programa */
+    OP_COUNT
+} OpCode;
+
+/**
+ * @brief Instrucción del bytecode
+ */
+typedef struct {
+    /** Dirección de la rutina que la ejecuta (se rellena al primer uso) */
+    const void *handler;
+    /** Código de operación */
+    int op;
+    /** Primer operando */
+    int a;
+    /** Segundo operando */
+    int b;
+} Instr;
+
+/**
+ * @brief Programa compilado
+ */
+typedef struct Program {
+    /** Instrucciones */
+    Instr *code;
+    int ncode;
+    int cap_code;
+    /** Comandos simples referenciados por las instrucciones */
+    CommandPlan **cmds;
+    int ncmds;
+    int cap_cmds;
+    /** Subprogramas (cuerpos de funciones y subshells) */
+    struct Program **subs;
+    int nsubs;
+    int cap_subs;
+    /** Nombres de variables de bucles for y de funciones */
+    char **names;
+    int nnames;
+    int cap_names;
+    /** Número de ranuras para guardar estados de salida */
+    int nslots;
+    /** Contador de referencias (caché, funciones y ejecuciones activas) */
+    int refcount;
+    /** Indica si ya se rellenaron los handler de las instrucciones */
+    int threaded;
+} Program;
+
+/** Número de funciones de la shell definidas */
+extern int function_count;
+
+/** Profundidad de ejecución de la máquina virtual (0 si no está ejecutando) */
+extern int vm_depth;
+
+/** Se pone a 1 con Ctrl+C para abortar los bucles en ejecución */
+extern volatile sig_atomic_t vm_interrupted;
+
+/**
+ * @brief Compila un texto completo (una o varias líneas)
+ * @param text Texto a compilar
+ * @param out Programa compilado (solo si el resultado es 1)
+ * @return 1 si es correcto, 0 si está incompleto, -1 si hay error de sintaxis
+ */
+int program_compile(const char *text, Program **out);
+
+/**
+ * @brief Compila el contenido de una sustitución $(...)
+ * @param pp Posición tras "$(", se avanza hasta después del ')' final
+ * @param out Programa compilado (solo si el resultado es 1)
+ * @return 1 si es correcto, 0 si está incompleto, -1 si hay error de sintaxis
+ */
+int vm_compile_subst(const char **pp, Program **out);
+
+/**
+ * @brief Libera una referencia a un programa
+ * @param prog Programa (se libera al llegar a 0 referencias)
+ */
+void program_release(Program *prog);
+
+/**
+ * @brief Obtiene el programa de una línea desde la caché, compilándolo si falta
+ * @param line Línea de comando (tal como se guarda en el historial)
+ * @param result 1 si es correcto, 0 si está incompleto, -1 si hay error
+ * @return Programa de la línea o NULL si no se pudo compilar
+ */
+Program *program_cache_lookup(const char *line, int *result);
+
+/**
+ * @brief Ejecuta un programa en la máquina virtual
+ * @param prog Programa a ejecutar
+ */
+void vm_run(Program *prog);
+
+/**
+ * @brief Ejecuta un programa desde el nivel superior (línea o script)
+ * @param prog Programa a ejecutar
+ */
+void vm_execute(Program *prog);
+
+/**
+ * @brief Ejecuta un programa en un hijo y captura su salida estándar
+ * @param prog Programa a ejecutar
+ * @return Salida capturada sin saltos de línea finales (reservada con malloc)
+ */
+char *vm_capture(Program *prog);
+
+/**
+ * @brief Llama a una función de la shell si existe
+ * @param argv Argumentos (argv[0] es el nombre de la función)
+ * @return 1 si la función existía y se ejecutó, 0 si no
+ */
+int vm_call_function(char **argv);
+
+/**
+ * @brief Indica si hay una función de la shell con ese nombre
+ * @param name Nombre
+ * @return 1 si existe, 0 si no
+ */
+int vm_function_exists(const char *name);
+
+#endif // VM_H